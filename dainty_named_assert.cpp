@@ -27,8 +27,11 @@
 #include <execinfo.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <assert.h>
-#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <atomic>
 #include "dainty_named_terminal.h"
 #include "dainty_named_assert.h"
 
@@ -36,21 +39,192 @@ namespace dainty
 {
 namespace named
 {
-  using namespace terminal;
+  namespace
+  {
+    // formats into a stack buffer and writes to stderr, no malloc and no
+    // stdio, so that it can run from a signal handler or with locks held.
+    class t_writer_ {
+    public:
+      t_writer_& put(t_char c) {
+        if (len_ == sizeof(buf_))
+          flush();
+        buf_[len_++] = c;
+        return *this;
+      }
+
+      t_writer_& put(P_cstr_ str) {
+        for (; str && *str; ++str)
+          put(*str);
+        return *this;
+      }
+
+      t_writer_& put(P_cstr_ str, t_n_ n) {
+        for (t_n_ ix = 0; ix < n; ++ix)
+          put(str[ix]);
+        return *this;
+      }
+
+      t_writer_& put_hex(t_uint64 value) {
+        t_n_ shift = 60;
+        while (shift && !(value >> shift))
+          shift -= 4;
+        for (;; shift -= 4) {
+          put("0123456789abcdef"[value >> shift & 0xf]);
+          if (!shift)
+            break;
+        }
+        return *this;
+      }
+
+      t_writer_& put(t_uint64 value) {
+        t_char tmp[20];
+        t_n_ n = 0;
+        do {
+          tmp[n++] = (t_char)('0' + value % 10);
+          value /= 10;
+        } while (value);
+        while (n)
+          put(tmp[--n]);
+        return *this;
+      }
+
+      t_void flush() {
+        for (t_n_ pos = 0; pos < len_; ) {
+          auto done = ::write(STDERR_FILENO, buf_ + pos, len_ - pos);
+          if (done < 0 && errno == EINTR)
+            continue;
+          if (done <= 0)
+            break;
+          pos += done;
+        }
+        len_ = 0;
+      }
+
+    private:
+      t_char buf_[256];
+      t_n_   len_ = 0;
+    };
+
+    // backtrace() loads libgcc on its first call, which allocates.
+    struct t_preload_ {
+      t_preload_() {
+        p_void array[1];
+        backtrace(array, 1);
+      }
+    } preload_;
+
+    // how long a later assert waits for the first to abort.
+    constexpr t_n_ WAIT_FIRST_MS_ = 5000;
+
+    // thread id of the first assert, 0 while there is none.
+    std::atomic<t_long>             asserting_{0};
+    std::atomic<t_assert_backtrace> backtrace_{BACKTRACE_SYMBOLS};
+
+    // "start-end perms offset dev inode path", only executable file
+    // mappings are kept.
+    t_void put_map_(t_writer_& writer, P_cstr_ line, t_n_ n) {
+      P_cstr_ fields[6];
+      t_n_    lens[6] = {};
+      t_n_    field = 0, pos = 0;
+      for (; field < 6 && pos < n; ++field) {
+        while (pos < n && line[pos] == ' ')
+          ++pos;
+        fields[field] = line + pos;
+        if (field == 5) {
+          lens[field] = n - pos;
+          break;
+        }
+        while (pos < n && line[pos] != ' ')
+          ++pos;
+        lens[field] = line + pos - fields[field];
+      }
+      if (field != 5 || lens[1] < 3 || fields[1][2] != 'x' || !lens[5] ||
+          fields[5][0] != '/')
+        return;
+      writer.put("bt-map ").put(fields[0], lens[0]).put(' ')
+            .put(fields[2], lens[2]).put(' ').put(fields[5], lens[5])
+            .put('\n');
+    }
+
+    t_void put_maps_(t_writer_& writer) {
+      auto fd = ::open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+      if (fd == -1)
+        return;
+      t_char buf[1024], line[512];
+      t_n_   len = 0;
+      for (;;) {
+        auto n = ::read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+          continue;
+        if (n <= 0)
+          break;
+        for (t_ix_ ix = 0; ix < (t_n_)n; ++ix) {
+          if (buf[ix] == '\n') {
+            put_map_(writer, line, len);
+            len = 0;
+          } else if (len < sizeof(line))
+            line[len++] = buf[ix]; // longer paths are cut
+        }
+      }
+      ::close(fd);
+    }
+
+    t_void put_record_(t_writer_& writer, p_void* frames, t_n_ n) {
+      writer.put("bt-record 1 pid ").put((t_uint64)getpid())
+            .put(" frames ").put((t_uint64)n).put('\n');
+      put_maps_(writer);
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        writer.put("bt-frame ").put_hex((t_uint64)frames[ix]).put('\n');
+      writer.put("bt-end\n");
+    }
+  }
+
+  t_void set_assert_backtrace(t_assert_backtrace backtrace) {
+    backtrace_.store(backtrace, std::memory_order_relaxed);
+  }
+
+  t_assert_backtrace get_assert_backtrace() {
+    return backtrace_.load(std::memory_order_relaxed);
+  }
 
   t_void assert_now(P_cstr reason) {
-    t_out{FMT, "assert: %s\n", get(reason)};
+    // the first assert writes the report. a later one from another thread
+    // prints its reason and waits for the process to be aborted by the
+    // first, so that the report is not cut short, but no longer than
+    // WAIT_FIRST_MS_ in case the first hangs. a later one from the thread
+    // of the first (it asserted while reporting) aborts at once.
+    const t_long tid = ::syscall(SYS_gettid);
+    t_long owner = 0;
+    auto first = asserting_.compare_exchange_strong(owner, tid,
+                                                    std::memory_order_acq_rel);
 
-    p_void array[20];
-    auto size = backtrace(array, 20);
+    t_writer_ writer;
+    writer.put("assert: ").put(get(reason)).put("\n");
+    if (!first) {
+      writer.flush();
+      if (owner == tid)
+        abort();
+      for (t_n_ ms = 0; ms < WAIT_FIRST_MS_; ms += 10) {
+        struct timespec ts{0, 10000000};
+        nanosleep(&ts, nullptr);
+      }
+      abort();
+    }
 
-    backtrace_symbols_fd(array, size, STDERR_FILENO);
+    terminal::try_flush_all_out();
 
-    fflush(stdout);
-    fflush(stderr);
+    p_void array[20];
+    auto size = backtrace(array, 20);
+    if (get_assert_backtrace() == BACKTRACE_RAW) {
+      put_record_(writer, array, size);
+      writer.flush();
+    } else {
+      writer.put("backtrace of pid ").put((t_uint64)getpid()).put(":\n");
+      writer.flush();
+      backtrace_symbols_fd(array, size, STDERR_FILENO);
+    }
 
-    assert(0);
+    abort();
   }
 }
 }
-
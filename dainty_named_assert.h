@@ -29,23 +29,102 @@
 
 #include "dainty_named.h"
 
+// assert: report a broken invariant on stderr, with a backtrace, and abort.
+//
+//   assert_now is cold and does not return, so the compiler moves its call
+//   out of the hot path and lays out the check as the untaken branch.
+//
+//   checks have a level, and each module has a level too, fixed at compile
+//   time. a check is compiled in when its level is at or below that of its
+//   module:
+//
+//     ASSERT_ALWAYS   - kept in every build (overflow, allocation).
+//     ASSERT_DEBUG    - argument checks that release builds can drop.
+//     ASSERT_PARANOID - expensive consistency checks.
+//
+//   DAINTY_NAMED_ASSERT_LEVEL sets the default level of all modules: 2
+//   (ASSERT_DEBUG), or 1 (ASSERT_ALWAYS) when NDEBUG is defined. a module
+//   uses its own macro that defaults to it, e.g.
+//   DAINTY_NAMED_STRING_ASSERT_LEVEL.
+//
+//     assert_if_true<ASSERT_DEBUG, STRING_ASSERT_LEVEL_>(ix >= n, reason);
+//
+//   the condition is still evaluated when the check is off. wrap costly
+//   conditions in if constexpr (is_assert_on<LEVEL, MODULE>()).
+//
+//   the backtrace is either resolved in the process (BACKTRACE_SYMBOLS),
+//   or written as a crash record of raw return addresses and the load
+//   addresses of the executable mappings (BACKTRACE_RAW):
+//
+//     bt-record 1 pid 551 frames 2
+//     bt-map 55d0c000-55d0e000 00001000 /usr/bin/app
+//     bt-frame 55d0c123
+//     bt-frame 7f3a12345678
+//     bt-end
+//
+//   which dainty_named_assert_symbolize resolves later, against unstripped
+//   copies of the binaries. no symbol lookup happens in the failing process.
+
+#ifndef DAINTY_NAMED_ASSERT_LEVEL
+#ifdef NDEBUG
+#define DAINTY_NAMED_ASSERT_LEVEL 1
+#else
+#define DAINTY_NAMED_ASSERT_LEVEL 2
+#endif
+#endif
+
 namespace dainty
 {
 namespace named
 {
+  enum t_assert_level {
+    ASSERT_ALWAYS   = 1,
+    ASSERT_DEBUG    = 2,
+    ASSERT_PARANOID = 3
+  };
+
+  constexpr t_assert_level ASSERT_LEVEL_ =
+    (t_assert_level)DAINTY_NAMED_ASSERT_LEVEL;
+
+  enum t_assert_backtrace { BACKTRACE_SYMBOLS, BACKTRACE_RAW };
+
+  t_void             set_assert_backtrace(t_assert_backtrace);
+  t_assert_backtrace get_assert_backtrace();
+
+  [[noreturn, gnu::cold, gnu::noinline]]
   t_void assert_now(P_cstr reason);
 
   inline
-   t_void assert_if_true(t_bool cond, P_cstr reason) {
-    if (cond)
+  t_void assert_if_true(t_bool cond, P_cstr reason) {
+    if (__builtin_expect(cond, false))
       assert_now(reason);
   }
 
   inline
   t_void assert_if_false(t_bool cond, P_cstr reason) {
-    if (!cond)
+    if (__builtin_expect(!cond, false))
       assert_now(reason);
   }
+
+  template<t_assert_level LEVEL, t_assert_level MODULE>
+  constexpr
+  t_bool is_assert_on() {
+    return LEVEL <= MODULE;
+  }
+
+  template<t_assert_level LEVEL, t_assert_level MODULE>
+  inline
+  t_void assert_if_true(t_bool cond, P_cstr reason) {
+    if constexpr (is_assert_on<LEVEL, MODULE>())
+      assert_if_true(cond, reason);
+  }
+
+  template<t_assert_level LEVEL, t_assert_level MODULE>
+  inline
+  t_void assert_if_false(t_bool cond, P_cstr reason) {
+    if constexpr (is_assert_on<LEVEL, MODULE>())
+      assert_if_false(cond, reason);
+  }
 }
 }
 
@@ -0,0 +1,156 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "dainty_named_assert_soft.h"
+
+namespace dainty
+{
+namespace named
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ RECORDS_ = 256;
+
+    // seq is 2*pos + 1 while record pos is written and 2*pos + 2 once it
+    // is complete, so a reader can tell a torn or an older record.
+    struct t_slot_ {
+      std::atomic<t_uint64> seq{0};
+      std::atomic<t_uint32> site{0};
+      std::atomic<t_uint64> ticks{0};
+      std::atomic<t_uint64> tid{0};
+      std::atomic<t_uint64> nth{0};
+    };
+
+    t_slot_                           slots_[RECORDS_];
+    std::atomic<t_uint64>             next_{0};
+    std::atomic<t_uint32>             ids_{0};
+    std::atomic<t_soft_assert_site_*> sites_{nullptr};
+
+    t_uint64 get_tid_() {
+      static thread_local t_uint64 tid_ = (t_uint64)::syscall(SYS_gettid);
+      return tid_;
+    }
+
+    // the first record of a site comes from nth == 0, which only one
+    // thread gets, so registering needs no lock.
+    t_void add_site_(r_soft_assert_site_ site) {
+      site.id.store(ids_.fetch_add(1, std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+      auto head = sites_.load(std::memory_order_relaxed);
+      do
+        site.next = head;
+      while (!sites_.compare_exchange_weak(head, &site,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+    }
+
+    t_soft_assert_info mk_info_(r_soft_assert_site_ site) {
+      t_soft_assert_info info;
+      info.id     = site.id.load(std::memory_order_relaxed);
+      info.file   = site.file;
+      info.line   = site.line;
+      info.reason = site.reason;
+      info.count  = site.count.load(std::memory_order_relaxed);
+      return info;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_void record_soft_assert_(r_soft_assert_site_ site, t_uint64 nth) {
+    if (!nth)
+      add_site_(site);
+
+    auto  pos  = next_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[pos % RECORDS_];
+    slot.seq.store(2*pos + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.site .store(site.id.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    slot.ticks.store(get(clock::get_ticks()), std::memory_order_relaxed);
+    slot.tid  .store(get_tid_(), std::memory_order_relaxed);
+    slot.nth  .store(nth, std::memory_order_relaxed);
+    slot.seq.store(2*pos + 2, std::memory_order_release);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_n_ get_soft_assert_sites_(p_soft_assert_info infos, t_n_ max) {
+    const auto head = sites_.load(std::memory_order_acquire);
+    t_n_ n = 0;
+    for (auto site = head; site; site = site->next)
+      ++n;
+    // the list is newest first, skip the newest that do not fit.
+    auto site = head;
+    for (; n > max; --n)
+      site = site->next;
+    for (t_n_ ix = n; ix; site = site->next)
+      infos[--ix] = mk_info_(*site);
+    return n;
+  }
+
+  t_n_ get_soft_assert_records_(p_soft_assert_record records, t_n_ max) {
+    const auto end   = next_.load(std::memory_order_acquire);
+    auto       begin = end > RECORDS_ ? end - RECORDS_ : 0;
+    if (end - begin > max)
+      begin = end - max;
+
+    t_n_ n = 0;
+    for (auto pos = begin; pos < end; ++pos) {
+      auto& slot = slots_[pos % RECORDS_];
+      if (slot.seq.load(std::memory_order_acquire) != 2*pos + 2)
+        continue;
+      t_soft_assert_record record;
+      record.site  = slot.site .load(std::memory_order_relaxed);
+      record.ticks = t_ticks{slot.ticks.load(std::memory_order_relaxed)};
+      record.tid   = slot.tid  .load(std::memory_order_relaxed);
+      record.nth   = slot.nth  .load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != 2*pos + 2)
+        continue;
+      records[n++] = record;
+    }
+    return n;
+  }
+
+  t_soft_assert_stats get_soft_assert_stats() {
+    t_soft_assert_stats stats;
+    for (auto site = sites_.load(std::memory_order_acquire); site;
+         site = site->next) {
+      ++stats.sites;
+      stats.violations += site->count.load(std::memory_order_relaxed);
+    }
+    stats.recorded = next_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
@@ -0,0 +1,135 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_ASSERT_SOFT_H_
+#define _DAINTY_NAMED_ASSERT_SOFT_H_
+
+// assert_soft: count broken invariants instead of aborting.
+//
+//   DAINTY_SOFT_ASSERT(n <= max, "queue longer than max");
+//
+//   every call site has a static t_soft_assert_site_ with its violation
+//   count. a violation costs one relaxed atomic increment. only some of
+//   them are recorded: the first 8 of a site and then the 16th, 32nd,
+//   64th, ... so that a hot site cannot flood the ring. the first record
+//   of a site also registers it.
+//
+//   a record holds the site id, a t_ticks timestamp, the thread id and
+//   which violation of the site it was. the ring keeps the last 256
+//   records of all sites and is written without locks, a record that is
+//   being overwritten while a snapshot is taken is skipped.
+//
+//   get_soft_assert_sites() and get_soft_assert_records() take snapshots.
+
+#include <atomic>
+#include "dainty_named_clock.h"
+
+namespace dainty
+{
+namespace named
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_soft_assert_site_ {
+    P_cstr_               file;
+    t_int                 line;
+    P_cstr_               reason;
+    std::atomic<t_uint64> count{0};
+    std::atomic<t_uint32> id{0};        // 0 until registered
+    t_soft_assert_site_*  next = nullptr;
+  };
+  using r_soft_assert_site_ = t_prefix<t_soft_assert_site_>::r_;
+
+  constexpr t_n_ SOFT_ASSERT_BURST_ = 8;
+
+  t_void record_soft_assert_(r_soft_assert_site_, t_uint64 nth);
+
+  inline
+  t_void soft_assert_(r_soft_assert_site_ site) {
+    auto nth = site.count.fetch_add(1, std::memory_order_relaxed);
+    if (nth < SOFT_ASSERT_BURST_ || !(nth & (nth + 1)))
+      record_soft_assert_(site, nth);
+  }
+
+#define DAINTY_SOFT_ASSERT(COND, REASON)                                      \
+  do {                                                                        \
+    static dainty::named::t_soft_assert_site_ site_{__FILE__, __LINE__,      \
+                                                    REASON};                  \
+    if (__builtin_expect(!(COND), 0))                                         \
+      dainty::named::soft_assert_(site_);                                     \
+  } while (0)
+
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_soft_assert_info {
+    t_uint32 id     = 0;
+    P_cstr_  file   = nullptr;
+    t_int    line   = 0;
+    P_cstr_  reason = nullptr;
+    t_uint64 count  = 0;                // violations so far
+  };
+  using p_soft_assert_info = t_prefix<t_soft_assert_info>::p_;
+
+  struct t_soft_assert_record {
+    t_uint32 site  = 0;                 // t_soft_assert_info::id, 0 while
+                                        // the site is being registered
+    t_ticks  ticks = t_ticks{0};
+    t_uint64 tid   = 0;
+    t_uint64 nth   = 0;                 // 0 for the first violation
+  };
+  using p_soft_assert_record = t_prefix<t_soft_assert_record>::p_;
+
+  struct t_soft_assert_stats {
+    t_uint64 sites      = 0;            // sites that failed at least once
+    t_uint64 violations = 0;
+    t_uint64 recorded   = 0;            // records written to the ring
+  };
+
+  t_n_ get_soft_assert_sites_  (p_soft_assert_info,   t_n_);
+  t_n_ get_soft_assert_records_(p_soft_assert_record, t_n_);
+
+  t_soft_assert_stats get_soft_assert_stats();
+
+  // the sites in the order they failed first, returns how many were
+  // filled in.
+  template<t_n_ N>
+  inline
+  t_n get_soft_assert_sites(t_soft_assert_info (&infos)[N]) {
+    return t_n{get_soft_assert_sites_(infos, N)};
+  }
+
+  // the newest records, oldest first. returns how many were filled in.
+  template<t_n_ N>
+  inline
+  t_n get_soft_assert_records(t_soft_assert_record (&records)[N]) {
+    return t_n{get_soft_assert_records_(records, N)};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+
+#endif
@@ -0,0 +1,249 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// assert_symbolize: resolve the BACKTRACE_RAW crash records in a log.
+//
+//   usage: dainty_named_assert_symbolize <log> [<path>=<unstripped>]...
+//
+//   every frame is mapped back to a file offset through its bt-map line,
+//   then to a virtual address through the PT_LOAD segments of the binary,
+//   and named from its .symtab (or .dynsym). a binary that was stripped in
+//   production is replaced by its unstripped copy with <path>=<unstripped>.
+//   the printed address can be handed to addr2line for file and line.
+
+#include <elf.h>
+#include <cxxabi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "dainty_named_file.h"
+
+using namespace dainty::named;
+
+namespace
+{
+  struct t_symbol_ {
+    t_uint64    addr;
+    t_uint64    size;
+    std::string name;
+  };
+
+  struct t_binary_ {
+    t_bool                 valid = false;
+    std::vector<Elf64_Phdr> loads;
+    std::vector<t_symbol_>  symbols; // sorted on addr
+  };
+
+  struct t_map_ {
+    t_uint64    begin;
+    t_uint64    end;
+    t_uint64    offset;
+    std::string path;
+  };
+
+  std::string demangle_(const char* name) {
+    int  status = 0;
+    auto out    = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (!out)
+      return name;
+    std::string str{out};
+    std::free(out);
+    return str;
+  }
+
+  t_void add_symbols_(t_binary_& binary, P_uchar base, t_n_ size,
+                      const Elf64_Shdr& table, const Elf64_Shdr& strings) {
+    if (table.sh_offset + table.sh_size > size ||
+        strings.sh_offset + strings.sh_size > size || !table.sh_entsize)
+      return;
+    auto syms = (const Elf64_Sym*)(base + table.sh_offset);
+    auto strs = (P_cstr_)(base + strings.sh_offset);
+    for (t_n_ ix = 0, n = table.sh_size/table.sh_entsize; ix < n; ++ix) {
+      auto& sym = syms[ix];
+      if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || !sym.st_value ||
+          sym.st_name >= strings.sh_size)
+        continue;
+      binary.symbols.push_back(
+        t_symbol_{sym.st_value, sym.st_size, demangle_(strs + sym.st_name)});
+    }
+  }
+
+  t_binary_ load_binary_(const std::string& path) {
+    t_binary_ binary;
+    file::t_mapped_file file{P_cstr{path.c_str()}};
+    if (file == INVALID)
+      return binary;
+
+    auto range = file.mk_range();
+    auto base  = (P_uchar)begin(range);
+    auto size  = get(range.n);
+    if (size < sizeof(Elf64_Ehdr) || std::memcmp(base, ELFMAG, SELFMAG) ||
+        base[EI_CLASS] != ELFCLASS64)
+      return binary;
+
+    auto& ehdr = *(const Elf64_Ehdr*)base;
+    if (ehdr.e_phoff + ehdr.e_phnum*sizeof(Elf64_Phdr) > size ||
+        ehdr.e_shoff + ehdr.e_shnum*sizeof(Elf64_Shdr) > size)
+      return binary;
+
+    auto phdrs = (const Elf64_Phdr*)(base + ehdr.e_phoff);
+    for (t_ix_ ix = 0; ix < ehdr.e_phnum; ++ix)
+      if (phdrs[ix].p_type == PT_LOAD)
+        binary.loads.push_back(phdrs[ix]);
+
+    auto shdrs = (const Elf64_Shdr*)(base + ehdr.e_shoff);
+    for (auto type : {SHT_SYMTAB, SHT_DYNSYM}) {
+      for (t_ix_ ix = 0; ix < ehdr.e_shnum; ++ix)
+        if (shdrs[ix].sh_type == (t_uint32)type &&
+            shdrs[ix].sh_link < ehdr.e_shnum)
+          add_symbols_(binary, base, size, shdrs[ix],
+                       shdrs[shdrs[ix].sh_link]);
+      if (!binary.symbols.empty())
+        break;
+    }
+    std::sort(binary.symbols.begin(), binary.symbols.end(),
+              [](const t_symbol_& lh, const t_symbol_& rh) {
+                return lh.addr < rh.addr;
+              });
+    binary.valid = true;
+    return binary;
+  }
+
+  const t_symbol_* find_symbol_(const t_binary_& binary, t_uint64 addr) {
+    auto it = std::upper_bound(binary.symbols.begin(), binary.symbols.end(),
+                               addr, [](t_uint64 value, const t_symbol_& sym) {
+                                 return value < sym.addr;
+                               });
+    if (it == binary.symbols.begin())
+      return nullptr;
+    --it;
+    if (it->size && addr >= it->addr + it->size)
+      return nullptr;
+    return &*it;
+  }
+
+  t_bool to_vaddr_(const t_binary_& binary, t_uint64 offset,
+                   t_uint64& vaddr) {
+    for (auto& load : binary.loads)
+      if (offset >= load.p_offset && offset < load.p_offset + load.p_filesz) {
+        vaddr = offset - load.p_offset + load.p_vaddr;
+        return true;
+      }
+    return false;
+  }
+
+  std::string mk_string_(string::R_crange range) {
+    return std::string{begin(range), get(range.n)};
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <log> [<path>=<unstripped>]...\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::map<std::string, std::string> replace;
+  for (int ix = 2; ix < argc; ++ix) {
+    auto eq = std::strchr(argv[ix], '=');
+    if (!eq) {
+      std::fprintf(stderr, "%s: expected <path>=<unstripped>\n", argv[ix]);
+      return 1;
+    }
+    replace[std::string{argv[ix], eq}] = eq + 1;
+  }
+
+  file::t_mapped_file file{P_cstr{argv[1]}};
+  if (file == INVALID) {
+    std::fprintf(stderr, "%s: %s\n", argv[1],
+                 std::strerror(get(file.get_errn())));
+    return 1;
+  }
+
+  std::map<std::string, std::unique_ptr<t_binary_>> binaries;
+  auto get_binary = [&](const std::string& path) -> const t_binary_& {
+    auto& binary = binaries[path];
+    if (!binary) {
+      auto found = replace.find(path);
+      binary.reset(new t_binary_{
+        load_binary_(found == replace.end() ? path : found->second)});
+    }
+    return *binary;
+  };
+
+  std::vector<t_map_> maps;
+  t_n_ frame = 0;
+  file.each_line([&](string::R_crange range) {
+    auto line = mk_string_(range);
+    if (!line.compare(0, 10, "bt-record ")) {
+      maps.clear();
+      frame = 0;
+      std::printf("%s\n", line.c_str());
+    } else if (!line.compare(0, 7, "bt-map ")) {
+      t_map_ map;
+      char   path[4096];
+      if (std::sscanf(line.c_str(), "bt-map %lx-%lx %lx %4095[^\n]",
+                      &map.begin, &map.end, &map.offset, path) == 4) {
+        map.path = path;
+        maps.push_back(map);
+      }
+    } else if (!line.compare(0, 9, "bt-frame ")) {
+      t_uint64 addr = std::strtoull(line.c_str() + 9, nullptr, 16);
+      // a return address points after the call, look up the call itself.
+      t_uint64 lookup = frame ? addr - 1 : addr;
+      std::printf("#%-2lu %#014lx", frame++, addr);
+
+      auto map = std::find_if(maps.begin(), maps.end(), [&](const t_map_& m) {
+        return lookup >= m.begin && lookup < m.end;
+      });
+      if (map == maps.end()) {
+        std::printf(" ??\n");
+        return;
+      }
+
+      auto& binary = get_binary(map->path);
+      t_uint64 vaddr = 0;
+      if (!binary.valid ||
+          !to_vaddr_(binary, lookup - map->begin + map->offset, vaddr)) {
+        std::printf(" ?? (%s)\n", map->path.c_str());
+        return;
+      }
+      if (auto sym = find_symbol_(binary, vaddr))
+        std::printf(" %s+%#lx", sym->name.c_str(), vaddr - sym->addr);
+      else
+        std::printf(" ??");
+      std::printf(" (%s+%#lx)\n", map->path.c_str(), vaddr);
+    } else if (line == "bt-end")
+      std::printf("\n");
+  });
+  return 0;
+}
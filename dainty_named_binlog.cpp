@@ -0,0 +1,557 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <errno.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "dainty_named_assert.h"
+#include "dainty_named_binlog.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace binlog
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    // a single producer, single consumer byte ring per thread. positions
+    // only grow, records never wrap: the end of the ring is skipped with a
+    // padding record (or silently when not even a header fits).
+    struct t_ring_ {
+      p_uchar               data = nullptr;
+      t_n_                  size = 0;
+      t_n_                  pad  = 0; // padding of the reserved record
+      std::atomic<t_bool>   busy{false}; // between reserve_ and commit_
+      alignas(64)
+      std::atomic<t_n_>     head{0};
+      alignas(64)
+      std::atomic<t_n_>     tail{0};
+      std::atomic<t_uint64> dropped{0};
+      std::atomic<t_bool>   closed{false};
+      t_ring_*              next = nullptr;
+    };
+
+    std::atomic<t_bool>   on_{false};
+    std::atomic<t_bool>   running_{false};
+    std::atomic<t_n_>     size_{64*1024};
+    std::atomic<t_uint64> sweeps_{0};
+    std::atomic<t_uint64> records_{0};
+    std::atomic<t_uint64> bytes_{0};
+    std::atomic<t_uint64> dropped_{0}; // of rings that are gone
+    t_fd_                 fd_   = 1;
+    t_binlog_mode         mode_ = BINLOG_TEXT;
+    std::thread           writer_;
+    std::mutex            rings_lock_;
+    t_ring_*              rings_ = nullptr;
+
+    // a closed ring is freed by the writer once it is drained, so a
+    // thread that logs from a later thread_local destructor must not find
+    // it again: it gets no ring and its records are dropped.
+    thread_local t_ring_* ring_   = nullptr;
+    thread_local t_bool   exited_ = false;
+
+    struct t_ring_owner_ {
+     ~t_ring_owner_() {
+        ring_->closed.store(true, std::memory_order_release);
+        ring_   = nullptr;
+        exited_ = true;
+      }
+    };
+
+    t_ring_* mk_ring_() {
+      auto ring = new t_ring_;
+      ring->size = size_.load(std::memory_order_relaxed);
+      ring->data = (p_uchar)std::malloc(ring->size);
+      if (!ring->data)
+        assert_now(P_cstr("malloc failed to allocate"));
+      {
+        std::lock_guard<std::mutex> guard{rings_lock_};
+        ring->next = rings_;
+        rings_     = ring;
+      }
+      ring_ = ring;
+      static thread_local t_ring_owner_ owner_;
+      return ring;
+    }
+
+//////////////////////////////////////////////////////////////////////////////
+
+    t_void write_(P_uchar data, t_n_ n) {
+      while (n) {
+        auto done = ::write(fd_, data, n);
+        if (done < 0) {
+          if (errno == EINTR)
+            continue;
+          return;
+        }
+        data += done;
+        n    -= done;
+      }
+    }
+
+    // the output of the writer thread.
+    struct t_out_ {
+      t_uchar data[64*1024];
+      t_n_    len = 0;
+
+      t_void flush() {
+        write_(data, len);
+        len = 0;
+      }
+
+      p_uchar reserve(t_n_ n) {
+        if (len + n > sizeof(data))
+          flush();
+        return n > sizeof(data) ? nullptr : data + len;
+      }
+    };
+
+    t_out_                                  out_;
+    std::unordered_map<P_site_, t_uint32> sites_;
+
+    t_void put_(P_void src, t_n_ n) {
+      if (n > sizeof(out_.data)) {
+        out_.flush();
+        write_((P_uchar)src, n);
+        return;
+      }
+      std::memcpy(out_.reserve(n), src, n);
+      out_.len += n;
+    }
+
+    t_void put_text_(R_record_ record) {
+      t_char line[1024];
+      auto ns = get(clock::to_nsec(t_ticks{record.ticks}));
+      auto n = std::snprintf(line, sizeof(line), "%llu.%09llu ",
+                             (unsigned long long)(ns/1000000000),
+                             (unsigned long long)(ns%1000000000));
+      n += format_(line + n, sizeof(line) - n - 1, record.site->fmt,
+                   record.site->types, record.site->types_n,
+                   (P_uchar)(&record + 1), (P_uchar)&record + record.size);
+      if ((t_n_)n > sizeof(line) - 2)
+        n = sizeof(line) - 2;
+      line[n++] = '\n';
+      put_(line, n);
+    }
+
+    t_void put_binary_(R_record_ record) {
+      auto site = record.site;
+      auto iter = sites_.find(site);
+      if (iter == sites_.end()) {
+        t_site_entry_ entry;
+        entry.kind    = ENTRY_SITE_;
+        entry.id      = sites_.size();
+        entry.line    = site->line;
+        entry.types_n = site->types_n;
+        entry.fmt_n   = std::strlen(site->fmt);
+        entry.file_n  = std::strlen(site->file);
+        put_(&entry, sizeof(entry));
+        put_(site->fmt,   entry.fmt_n);
+        put_(site->file,  entry.file_n);
+        put_(site->types, entry.types_n);
+        iter = sites_.emplace(site, entry.id).first;
+      }
+      t_event_entry_ entry;
+      entry.kind  = ENTRY_EVENT_;
+      entry.id    = iter->second;
+      entry.ticks = record.ticks;
+      entry.size  = record.size - sizeof(t_record_);
+      put_(&entry, sizeof(entry));
+      put_(&record + 1, entry.size);
+    }
+
+    t_bool drain_(t_ring_& ring) {
+      const auto head = ring.head.load(std::memory_order_acquire);
+      auto       tail = ring.tail.load(std::memory_order_relaxed);
+      if (tail == head)
+        return false;
+      while (tail != head) {
+        const auto off = tail & (ring.size - 1);
+        if (ring.size - off < sizeof(t_record_)) {
+          tail += ring.size - off;
+          continue;
+        }
+        auto& record = *(P_record_)(ring.data + off);
+        if (record.site) {
+          if (mode_ == BINLOG_TEXT)
+            put_text_(record);
+          else
+            put_binary_(record);
+          records_.fetch_add(1, std::memory_order_relaxed);
+          bytes_  .fetch_add(record.size, std::memory_order_relaxed);
+        }
+        tail += record.size;
+      }
+      ring.tail.store(tail, std::memory_order_release);
+      return true;
+    }
+
+    t_bool sweep_() {
+      t_bool busy = false;
+      std::lock_guard<std::mutex> guard{rings_lock_};
+      for (auto prev = &rings_; *prev; ) {
+        auto ring = *prev;
+        auto closed = ring->closed.load(std::memory_order_acquire);
+        busy |= drain_(*ring);
+        if (closed) {
+          dropped_.fetch_add(ring->dropped.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+          *prev = ring->next;
+          std::free(ring->data);
+          delete ring;
+        } else
+          prev = &ring->next;
+      }
+      if (out_.len)
+        out_.flush();
+      sweeps_.fetch_add(1, std::memory_order_release);
+      return busy;
+    }
+
+    t_void run_writer_() {
+      for (;;) {
+        if (sweep_())
+          continue;
+        if (!running_.load(std::memory_order_acquire)) {
+          sweep_();
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+      }
+    }
+
+//////////////////////////////////////////////////////////////////////////////
+
+    // a printf conversion without its length modifier.
+    struct t_spec_ {
+      t_char text[32];
+      t_n_   len;
+      t_char conv;
+    };
+
+    P_cstr_ mk_spec_(t_spec_& spec, P_cstr_ p, const P_uchar* starts,
+                     t_n_& arg, t_n_ args_n) {
+      spec.len = 0;
+      spec.text[spec.len++] = *p++; // '%'
+      auto copy = [&](t_char c) {
+        if (spec.len < sizeof(spec.text) - 8)
+          spec.text[spec.len++] = c;
+      };
+      auto copy_star = [&]() {
+        t_int64 value = 0;
+        if (arg < args_n)
+          std::memcpy(&value, starts[arg++], 8);
+        t_char tmp[24];
+        auto n = std::snprintf(tmp, sizeof(tmp), "%d", (t_int)value);
+        for (t_int i = 0; i < n; ++i)
+          copy(tmp[i]);
+      };
+      while (*p && std::strchr("-+ #0'", *p))
+        copy(*p++);
+      if (*p == '*') {
+        copy_star();
+        ++p;
+      }
+      while (*p >= '0' && *p <= '9')
+        copy(*p++);
+      if (*p == '.') {
+        copy(*p++);
+        if (*p == '*') {
+          copy_star();
+          ++p;
+        }
+        while (*p >= '0' && *p <= '9')
+          copy(*p++);
+      }
+      while (*p && std::strchr("hlLqjzt", *p))
+        ++p;
+      spec.conv = *p ? *p++ : '\0';
+      spec.text[spec.len] = '\0';
+      return p;
+    }
+
+    // the number of argument slots that lie within [args, end), the
+    // starts of the first max of them are kept.
+    t_n_ walk_args_(P_uchar* starts, t_n_ max, const t_uchar* types,
+                    t_n_ types_n, P_uchar args, P_uchar end) {
+      t_n_ i = 0;
+      for (; i < types_n; ++i) {
+        t_n_ left = end - args, slot = 8;
+        if (left < slot)
+          break;
+        if (types[i] == ARG_STR_) {
+          t_uint64 len;
+          std::memcpy(&len, args, 8);
+          if (len > left - 8 || len > INT_MAX)
+            break;
+          slot += (len + 7)/8*8;
+          if (slot > left)
+            break;
+        }
+        if (i < max)
+          starts[i] = args;
+        args += slot;
+      }
+      return i;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_bool check_args_(const t_uchar* types, t_n_ types_n, P_uchar args,
+                     P_uchar end) {
+    return walk_args_(nullptr, 0, types, types_n, args, end) == types_n;
+  }
+
+  t_n_ format_(p_cstr_ dst, t_n_ max, P_cstr_ fmt, const t_uchar* types,
+               t_n_ types_n, P_uchar args, P_uchar end) {
+    // the argument slots, strings take more than one. first pass finds
+    // where every argument starts, the ones past end count as missing.
+    P_uchar starts[64];
+    types_n = walk_args_(starts, 64, types, types_n < 64 ? types_n : 64,
+                         args, end);
+
+    t_n_ pos = 0, arg = 0;
+    auto room = [&]() -> t_n_ { return pos < max ? max - pos : 0; };
+    auto put  = [&](P_cstr_ src, t_n_ n) {
+      if (pos < max)
+        std::memcpy(dst + pos, src, n < max - pos ? n : max - pos);
+      pos += n;
+    };
+
+    for (auto p = fmt; *p; ) {
+      if (*p != '%' || p[1] == '%') {
+        auto end = p[0] == '%' ? p + 1 : p;
+        while (*end && *end != '%')
+          ++end;
+        put(p, end - p);
+        p = end + (p[0] == '%' ? 1 : 0);
+        continue;
+      }
+
+      t_spec_ spec;
+      p = mk_spec_(spec, p, starts, arg, types_n);
+
+      if (!spec.conv || spec.conv == 'n' || arg >= types_n) {
+        if (spec.conv == 'n')
+          ++arg;
+        continue;
+      }
+
+      const auto type = types[arg];
+      const auto src  = starts[arg++];
+      t_uint64 raw;
+      std::memcpy(&raw, src, 8);
+      t_double real;
+      std::memcpy(&real, src, 8);
+      t_int64  sint = type == ARG_DOUBLE_ ? (t_int64)real : (t_int64)raw;
+
+      auto mk = [&](P_cstr_ suffix) {
+        std::strcpy(spec.text + spec.len, suffix);
+      };
+      t_int n = 0;
+      switch (spec.conv) {
+        case 'd': case 'i':
+          mk("lld");
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            (long long)sint);
+          break;
+        case 'o': case 'u': case 'x': case 'X': {
+          t_char conv[4] = {'l', 'l', spec.conv, '\0'};
+          mk(conv);
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            (unsigned long long)sint);
+        } break;
+        case 'c':
+          mk("c");
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            (t_int)sint);
+          break;
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A': {
+          t_char conv[2] = {spec.conv, '\0'};
+          mk(conv);
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            type == ARG_DOUBLE_ ? real : (t_double)sint);
+        } break;
+        case 'p':
+          mk("p");
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            (p_void)(std::uintptr_t)raw);
+          break;
+        case 's': {
+          if (type != ARG_STR_) {
+            put("(?)", 3);
+            break;
+          }
+          // not terminated in the record, bound it with a precision.
+          t_int len  = (t_int)raw;
+          auto  prec = std::strchr(spec.text, '.');
+          if (prec) {
+            auto limit = std::atoi(prec + 1);
+            if (limit < len)
+              len = limit;
+            spec.len = prec - spec.text;
+          }
+          mk(".*s");
+          n = std::snprintf(dst + (pos < max ? pos : 0), room(), spec.text,
+                            len, (P_cstr_)(src + 8));
+        } break;
+        default:
+          break;
+      }
+      if (n > 0)
+        pos += n;
+    }
+    if (max)
+      dst[pos < max ? pos : max - 1] = '\0';
+    return pos;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  p_uchar reserve_(t_n_ size) {
+    if (!on_.load(std::memory_order_relaxed))
+      return nullptr;
+
+    auto ring = ring_;
+    if (!ring) {
+      if (exited_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      ring = mk_ring_();
+    }
+
+    // stop_binlog waits for busy rings, so a record reserved while on_ is
+    // still set is written by the last sweep.
+    ring->busy.store(true, std::memory_order_seq_cst);
+    if (!on_.load(std::memory_order_seq_cst)) {
+      ring->busy.store(false, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    const auto pos = ring->head.load(std::memory_order_relaxed);
+    const auto off = pos & (ring->size - 1);
+    const auto pad = off + size > ring->size ? ring->size - off : 0;
+    if (pos + pad + size - ring->tail.load(std::memory_order_acquire) >
+        ring->size) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      ring->busy.store(false, std::memory_order_relaxed);
+      return nullptr;
+    }
+    if (pad >= sizeof(t_record_)) {
+      t_record_ padding{nullptr, 0, pad};
+      std::memcpy(ring->data + off, &padding, sizeof(padding));
+    }
+    ring->pad = pad;
+    return ring->data + ((pos + pad) & (ring->size - 1));
+  }
+
+  t_void commit_(t_n_ size) {
+    auto ring = ring_;
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + ring->pad +
+                     size, std::memory_order_release);
+    ring->busy.store(false, std::memory_order_release);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_validity start_binlog(R_binlog_params params) {
+    if (running_.load())
+      return INVALID;
+
+    t_n_ size = 4096;
+    while (size < get(params.size))
+      size *= 2;
+    size_.store(size, std::memory_order_relaxed);
+    fd_   = get(params.fd);
+    mode_ = params.mode;
+    sites_.clear();
+
+    if (mode_ == BINLOG_BINARY) {
+      t_file_header_ header;
+      header.magic          = BINLOG_MAGIC_;
+      header.version        = BINLOG_VERSION_;
+      header.ticks_per_sec  = clock::get_clock_info().ticks_per_sec;
+      write_((P_uchar)&header, sizeof(header));
+    }
+
+    running_.store(true, std::memory_order_release);
+    writer_ = std::thread{run_writer_};
+    on_.store(true, std::memory_order_release);
+    return VALID;
+  }
+
+  t_void stop_binlog() {
+    if (!running_.load())
+      return;
+    on_.store(false, std::memory_order_seq_cst);
+    {
+      // records under way are committed before the last sweep.
+      std::lock_guard<std::mutex> guard{rings_lock_};
+      for (auto ring = rings_; ring; ring = ring->next)
+        while (ring->busy.load(std::memory_order_acquire))
+          std::this_thread::yield();
+    }
+    running_.store(false, std::memory_order_release);
+    writer_.join();
+  }
+
+  t_void flush_binlog() {
+    if (!running_.load(std::memory_order_acquire))
+      return;
+    // two full sweeps after this point drained what was there before it.
+    const auto sweeps = sweeps_.load(std::memory_order_acquire);
+    while (sweeps_.load(std::memory_order_acquire) < sweeps + 2)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  t_binlog_stats get_binlog_stats() {
+    t_binlog_stats stats;
+    stats.records = records_.load(std::memory_order_relaxed);
+    stats.bytes   = bytes_  .load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard{rings_lock_};
+    for (auto ring = rings_; ring; ring = ring->next)
+      stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
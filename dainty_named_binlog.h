@@ -0,0 +1,287 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_BINLOG_H_
+#define _DAINTY_NAMED_BINLOG_H_
+
+// binlog: deferred logging, the format is done later and elsewhere.
+//
+//   DAINTY_BINLOG("%s took %d us", name, us);
+//
+//   the calling thread only copies a pointer to the static call site, a
+//   t_ticks timestamp and the raw arguments (strings by value) into a ring
+//   of its own. no formatting, no locks, no system calls. a background
+//   thread drains the rings and either
+//
+//     BINLOG_TEXT   - formats the records with printf rules and writes text.
+//     BINLOG_BINARY - writes them as is, for dainty_named_binlog_decode.
+//
+//   the format is checked at compile time like printf. arguments can be
+//   integers, enums, floating point, pointers and c strings (%s). a record
+//   that does not fit in the ring of its thread is dropped and counted, as
+//   is one logged by a thread after its ring was closed at thread exit.
+//   stop_binlog() writes every record that was under way when it started.
+
+#include <cstdint>
+#include <type_traits>
+#include "dainty_named_clock.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace binlog
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  using named::t_void;
+  using named::t_bool;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_fd;
+  using named::t_uchar;
+  using named::P_cstr_;
+
+  enum t_binlog_mode { BINLOG_TEXT, BINLOG_BINARY };
+
+  struct t_binlog_params {
+    t_fd          fd   = t_fd{1};
+    t_binlog_mode mode = BINLOG_TEXT;
+    t_n           size = t_n{64*1024}; // ring per thread, a power of 2
+
+    t_binlog_params() = default;
+    t_binlog_params(t_fd _fd, t_binlog_mode _mode, t_n _size = t_n{64*1024})
+      : fd(_fd), mode(_mode), size(_size) {
+    }
+  };
+  using R_binlog_params = t_prefix<t_binlog_params>::R_;
+
+  struct t_binlog_stats {
+    t_uint64 records = 0; // written by the background thread
+    t_uint64 bytes   = 0;
+    t_uint64 dropped = 0;
+  };
+
+  t_validity     start_binlog(R_binlog_params = t_binlog_params{});
+  t_void         stop_binlog ();
+  t_void         flush_binlog(); // waits until all records are written
+  t_binlog_stats get_binlog_stats();
+
+///////////////////////////////////////////////////////////////////////////////
+
+  enum t_arg_ : t_uchar { ARG_INT_, ARG_UINT_, ARG_DOUBLE_, ARG_PTR_, ARG_STR_ };
+
+  struct t_site_ {
+    P_cstr_        fmt;
+    P_cstr_        file;
+    t_int          line;
+    const t_uchar* types;
+    t_n_           types_n;
+  };
+  using P_site_ = t_prefix<t_site_>::P_;
+
+  // a record in a ring: header, then one 8 byte slot per argument. a
+  // string is its length and its bytes, padded to 8.
+  struct t_record_ {
+    P_site_  site; // nullptr: padding to the end of the ring
+    t_uint64 ticks;
+    t_uint64 size;
+  };
+
+  template<class T, class = void>
+  struct t_arg_type_ {
+    static_assert(std::is_pointer<T>::value, "binlog: unsupported argument");
+    static constexpr t_uchar value = ARG_PTR_;
+  };
+
+  template<class T>
+  struct t_arg_type_<T, std::enable_if_t<std::is_integral<T>::value ||
+                                         std::is_enum<T>::value>> {
+    static constexpr t_uchar value =
+      std::is_unsigned<T>::value ? ARG_UINT_ : ARG_INT_;
+  };
+
+  template<class T>
+  struct t_arg_type_<T, std::enable_if_t<std::is_floating_point<T>::value>> {
+    static constexpr t_uchar value = ARG_DOUBLE_;
+  };
+
+  template<> struct t_arg_type_<P_cstr_> {
+    static constexpr t_uchar value = ARG_STR_;
+  };
+
+  template<> struct t_arg_type_<p_cstr_> {
+    static constexpr t_uchar value = ARG_STR_;
+  };
+
+  template<class... A>
+  struct t_arg_types_ {
+    static constexpr t_uchar TYPES[sizeof...(A) + 1] = {
+      t_arg_type_<A>::value..., 0};
+    static constexpr t_n_ N = sizeof...(A);
+  };
+
+  template<class... A>
+  t_arg_types_<std::decay_t<A>...> mk_arg_types_(const A&...);
+
+  inline t_void check_fmt_(P_cstr_, ...) __attribute__((format(printf, 1, 2)));
+  inline t_void check_fmt_(P_cstr_, ...) { }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  p_uchar reserve_(t_n_);
+  t_void  commit_ (t_n_);
+
+  template<class T>
+  inline
+  t_n_ get_arg_size_(const T&) {
+    return 8;
+  }
+
+  inline
+  t_n_ get_arg_size_(P_cstr_ str) {
+    return 8 + ((str ? __builtin_strlen(str) : 6) + 7)/8*8;
+  }
+
+  inline
+  t_n_ get_arg_size_(p_cstr_ str) {
+    return get_arg_size_((P_cstr_)str);
+  }
+
+  template<class T>
+  inline
+  p_uchar put_arg_(p_uchar dst, const T& arg) {
+    if constexpr (std::is_floating_point<T>::value) {
+      t_double value = arg;
+      __builtin_memcpy(dst, &value, 8);
+    } else if constexpr (std::is_pointer<T>::value) {
+      auto value = (t_uint64)(std::uintptr_t)arg;
+      __builtin_memcpy(dst, &value, 8);
+    } else if constexpr (std::is_unsigned<T>::value) {
+      t_uint64 value = arg;
+      __builtin_memcpy(dst, &value, 8);
+    } else {
+      t_int64 value = (t_int64)arg;
+      __builtin_memcpy(dst, &value, 8);
+    }
+    return dst + 8;
+  }
+
+  inline
+  p_uchar put_arg_(p_uchar dst, P_cstr_ str) {
+    if (!str)
+      str = "(null)";
+    t_uint64 len = __builtin_strlen(str);
+    __builtin_memcpy(dst, &len, 8);
+    __builtin_memcpy(dst + 8, str, len);
+    return dst + 8 + (len + 7)/8*8;
+  }
+
+  inline
+  p_uchar put_arg_(p_uchar dst, p_cstr_ str) {
+    return put_arg_(dst, (P_cstr_)str);
+  }
+
+  template<class... A>
+  inline
+  t_void log_(P_site_ site, const A&... args) {
+    const t_n_ size = sizeof(t_record_) + (get_arg_size_(args) + ... + 0);
+    auto dst = reserve_(size);
+    if (dst) {
+      t_record_ record{site, get(clock::get_ticks()), size};
+      __builtin_memcpy(dst, &record, sizeof(record));
+      dst += sizeof(record);
+      ((dst = put_arg_(dst, args)), ...);
+      commit_(size);
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // BINLOG_BINARY output: a header, then site and event entries in native
+  // endian. a site entry comes before the first event that uses it and is
+  // followed by its format, file and argument types. an event entry is
+  // followed by its argument slots.
+
+  constexpr t_uint32 BINLOG_MAGIC_   = 0x4c424e44; // "DNBL"
+  constexpr t_uint32 BINLOG_VERSION_ = 1;
+
+  enum t_entry_kind_ : t_uint32 { ENTRY_SITE_ = 1, ENTRY_EVENT_ = 2 };
+
+  struct t_file_header_ {
+    t_uint32 magic;
+    t_uint32 version;
+    t_uint64 ticks_per_sec;
+  };
+
+  struct t_site_entry_ {
+    t_uint32 kind;
+    t_uint32 id;
+    t_uint32 line;
+    t_uint32 types_n;
+    t_uint32 fmt_n;
+    t_uint32 file_n;
+  };
+
+  struct t_event_entry_ {
+    t_uint32 kind;
+    t_uint32 id;
+    t_uint64 ticks;
+    t_uint64 size;
+  };
+
+  using R_record_ = t_prefix<t_record_>::R_;
+  using P_record_ = t_prefix<t_record_>::P_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // format one record with printf rules, as the background thread and the
+  // decoder do. returns the length it needed, like snprintf. arguments
+  // that do not lie within [args, end) are treated as missing.
+  t_n_ format_(p_cstr_ dst, t_n_ max, P_cstr_ fmt, const t_uchar* types,
+               t_n_ types_n, P_uchar args, P_uchar end);
+
+  // true if all types_n argument slots lie within [args, end).
+  t_bool check_args_(const t_uchar* types, t_n_ types_n, P_uchar args,
+                     P_uchar end);
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#define DAINTY_BINLOG(fmt, ...)                                               \
+  do {                                                                        \
+    using t_types_ =                                                          \
+      decltype(dainty::named::binlog::mk_arg_types_(__VA_ARGS__));            \
+    static constexpr dainty::named::binlog::t_site_ site_{                    \
+      fmt, __FILE__, __LINE__, t_types_::TYPES, t_types_::N};                 \
+    if (false)                                                                \
+      dainty::named::binlog::check_fmt_(fmt, ##__VA_ARGS__);                  \
+    dainty::named::binlog::log_(&site_, ##__VA_ARGS__);                       \
+  } while (false)
+
+#endif
@@ -0,0 +1,140 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// binlog_decode: print a BINLOG_BINARY file as text, one record per line.
+//
+//   usage: dainty_named_binlog_decode <file>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "dainty_named_file.h"
+#include "dainty_named_binlog.h"
+
+using namespace dainty::named;
+using namespace dainty::named::binlog;
+
+namespace
+{
+  struct t_site_info_ {
+    std::string    fmt; // not terminated in the file
+    const t_uchar* types   = nullptr;
+    t_n_           types_n = 0;
+  };
+
+  template<class T>
+  t_bool take_(P_uchar& pos, P_uchar end, T& value) {
+    if ((t_n_)(end - pos) < sizeof(T))
+      return false;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s <file>\n", argv[0]);
+    return 1;
+  }
+
+  file::t_mapped_file file{P_cstr{argv[1]}};
+  if (file == INVALID) {
+    std::fprintf(stderr, "%s: %s\n", argv[1],
+                 std::strerror(get(file.get_errn())));
+    return 1;
+  }
+
+  auto range = file.mk_range();
+  auto pos   = (P_uchar)begin(range);
+  auto end   = pos + get(range.n);
+
+  t_file_header_ header;
+  if (!take_(pos, end, header) || header.magic != BINLOG_MAGIC_ ||
+      header.version != BINLOG_VERSION_) {
+    std::fprintf(stderr, "%s: not a binlog file\n", argv[1]);
+    return 1;
+  }
+  const auto per_sec = header.ticks_per_sec;
+  if (!per_sec) { // the divisor of every timestamp
+    std::fprintf(stderr, "%s: corrupt header, ticks_per_sec is 0\n",
+                 argv[1]);
+    return 1;
+  }
+
+  std::vector<t_site_info_> sites;
+  std::vector<t_char>       line(4096);
+  while (pos < end) {
+    t_uint32 kind; // both entries start with it
+    auto peek = pos;
+    if (!take_(peek, end, kind))
+      break;
+    if (kind == ENTRY_SITE_) {
+      t_site_entry_ entry;
+      if (!take_(pos, end, entry) ||
+          (t_n_)(end - pos) < (t_n_)entry.fmt_n + entry.file_n + entry.types_n)
+        break;
+      if (sites.size() <= entry.id)
+        sites.resize(entry.id + 1);
+      auto& site = sites[entry.id];
+      site.fmt.assign((P_cstr_)pos, entry.fmt_n);
+      site.types   = pos + entry.fmt_n + entry.file_n;
+      site.types_n = entry.types_n;
+      pos += entry.fmt_n + entry.file_n + entry.types_n;
+    } else if (kind == ENTRY_EVENT_) {
+      t_event_entry_ entry;
+      if (!take_(pos, end, entry) || (t_n_)(end - pos) < entry.size ||
+          entry.id >= sites.size())
+        break;
+      auto& site     = sites[entry.id];
+      auto  fmt      = site.fmt.c_str();
+      auto  args_end = pos + entry.size;
+      if (!check_args_(site.types, site.types_n, pos, args_end))
+        break;
+      auto  need = format_(line.data(), line.size(), fmt, site.types,
+                           site.types_n, pos, args_end);
+      if (need >= line.size()) {
+        line.resize(need + 1);
+        format_(line.data(), line.size(), fmt, site.types, site.types_n,
+                pos, args_end);
+      }
+      std::printf("%llu.%09llu %s\n",
+                  (unsigned long long)(entry.ticks/per_sec),
+                  (unsigned long long)(entry.ticks%per_sec*1000000000/per_sec),
+                  line.data());
+      pos += entry.size;
+    } else
+      break;
+  }
+
+  if (pos != end) {
+    std::fprintf(stderr, "%s: corrupt entry at offset %lu\n", argv[1],
+                 (t_n_)(pos - (P_uchar)begin(range)));
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+#include "dainty_named_clock.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace clock
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    inline
+    t_uint64 get_mono_ns_() {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (t_uint64)ts.tv_sec*1000000000ull + ts.tv_nsec;
+    }
+
+#if defined(__x86_64__)
+    t_bool has_invariant_tsc_() {
+      t_uint a, b, c, d;
+      if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007)
+        return false;
+      __get_cpuid(0x80000007, &a, &b, &c, &d);
+      return d & (1u << 8);
+    }
+
+    // the tsc rate as reported by cpuid leaf 0x15, or 0.
+    t_uint64 get_cpuid_rate_() {
+      t_uint a, b, c, d;
+      if (__get_cpuid_max(0, nullptr) < 0x15)
+        return 0;
+      __cpuid(0x15, a, b, c, d);
+      if (!a || !b || !c)
+        return 0;
+      return (t_uint64)c*b/a;
+    }
+
+    // measure the rate over ~10ms, between two (short) pairs of reads.
+    t_uint64 measure_rate_() {
+      auto pair = [](t_uint64& ns, t_uint64& ticks) {
+        t_uint64 best = ~0ull;
+        for (t_int i = 0; i < 5; ++i) {
+          auto t0 = __rdtsc();
+          auto n  = get_mono_ns_();
+          auto t1 = __rdtsc();
+          if (t1 - t0 < best) {
+            best  = t1 - t0;
+            ns    = n;
+            ticks = t0 + (t1 - t0)/2;
+          }
+        }
+      };
+      t_uint64 ns0 = 0, ticks0 = 0, ns1 = 0, ticks1 = 0;
+      pair(ns0, ticks0);
+      while (get_mono_ns_() - ns0 < 10000000)
+        ;
+      pair(ns1, ticks1);
+      return (t_uint64)((unsigned __int128)(ticks1 - ticks0)*1000000000/
+                        (ns1 - ns0));
+    }
+#endif
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_clock_info calibrate_clock_() {
+    t_clock_info info;
+#if defined(__x86_64__)
+    if (!has_invariant_tsc_())
+      return info;
+    auto rate = get_cpuid_rate_();
+    if (!rate)
+      rate = measure_rate_();
+    if (rate < 1000000) // not believable
+      return info;
+
+    // the largest shift for which the multiplier still fits 64 bits.
+    t_uint32 shift = 32;
+    while (shift < 63 &&
+           ((unsigned __int128)1000000000 << (shift + 1))/rate <
+             ((unsigned __int128)1 << 63))
+      ++shift;
+
+    info.ticks_per_sec = rate;
+    info.mult  = (t_uint64)(((unsigned __int128)1000000000 << shift)/rate);
+    info.shift = shift;
+    info.tsc   = true;
+#endif
+    return info;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,141 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_CLOCK_H_
+#define _DAINTY_NAMED_CLOCK_H_
+
+// clock: cheap timestamps as t_ticks, converted to t_nsec when needed.
+//
+//   on x86-64 with an invariant tsc, get_ticks() is a single rdtsc. the
+//   tsc rate is taken from cpuid when it is reported, otherwise it is
+//   measured against CLOCK_MONOTONIC, on the first use of the clock so
+//   that all ticks come from the same source. to_nsec() converts with one
+//   128 bit multiply and a shift, no division.
+//
+//   elsewhere (or without an invariant tsc) the ticks are CLOCK_MONOTONIC
+//   nanoseconds read through the vdso, and to_nsec() is an identity.
+//
+//   ticks are only comparable within one boot of one machine.
+
+#include <time.h>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "dainty_named.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace clock
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_clock_info {
+    t_bool   tsc           = false; // ticks come from the tsc
+    t_uint64 ticks_per_sec = 1000000000;
+    t_uint64 mult          = 1;     // nsec = ticks*mult >> shift
+    t_uint32 shift         = 0;
+  };
+  using R_clock_info = t_prefix<t_clock_info>::R_;
+
+  t_clock_info calibrate_clock_();
+
+  inline
+  R_clock_info get_clock_info() {
+    static const t_clock_info info_ = calibrate_clock_();
+    return info_;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_ticks get_ticks() {
+#if defined(__x86_64__)
+    if (__builtin_expect(get_clock_info().tsc, 1))
+      return t_ticks{__rdtsc()};
+#endif
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return t_ticks{(t_ticks_)ts.tv_sec*1000000000ull + ts.tv_nsec};
+  }
+
+  // like get_ticks, but not started before earlier instructions finished.
+  inline
+  t_ticks get_ticks_ordered() {
+#if defined(__x86_64__)
+    if (__builtin_expect(get_clock_info().tsc, 1)) {
+      t_uint aux;
+      return t_ticks{__rdtscp(&aux)};
+    }
+#endif
+    return get_ticks();
+  }
+
+  inline
+  t_nsec to_nsec(t_ticks ticks) {
+#if defined(__x86_64__)
+    R_clock_info info = get_clock_info();
+    return t_nsec{(t_nsec_)(((unsigned __int128)get(ticks)*info.mult) >>
+                            info.shift)};
+#else
+    return t_nsec{(t_nsec_)get(ticks)}; // ticks are nanoseconds
+#endif
+  }
+
+  inline
+  t_ticks to_ticks(t_nsec nsec) {
+#if defined(__x86_64__)
+    return t_ticks{(t_ticks_)((unsigned __int128)get(nsec)*
+                              get_clock_info().ticks_per_sec/1000000000)};
+#else
+    return t_ticks{(t_ticks_)get(nsec)};
+#endif
+  }
+
+  inline t_nsec get_nsec() { return to_nsec(get_ticks()); }
+
+  inline
+  t_usec to_usec(t_nsec nsec) {
+    return t_usec{(t_usec_)(get(nsec)/1000)};
+  }
+
+  inline
+  t_msec to_msec(t_nsec nsec) {
+    return t_msec{(t_msec_)(get(nsec)/1000000)};
+  }
+
+  inline
+  t_sec to_sec(t_nsec nsec) {
+    return t_sec{(t_sec_)(get(nsec)/1000000000)};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -0,0 +1,162 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include "dainty_named_utility.h"
+#include "dainty_named_file.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace file
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    inline
+    t_int mk_advice_(t_advice advice) {
+      switch (advice) {
+        case ADVICE_SEQUENTIAL: return MADV_SEQUENTIAL;
+        case ADVICE_RANDOM:     return MADV_RANDOM;
+        case ADVICE_WILLNEED:   return MADV_WILLNEED;
+        default:
+          break;
+      }
+      return MADV_NORMAL;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_void t_line_iter::find_() {
+    next_ = begin_ == end_ ? nullptr
+                           : (P_cstr_)std::memchr(begin_, '\n', end_ - begin_);
+    if (!next_)
+      next_ = end_;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_mapped_file::t_mapped_file(t_fd fd, t_advice advice) {
+    map(fd, advice);
+  }
+
+  t_mapped_file::t_mapped_file(P_cstr path, t_advice advice) {
+    map(path, advice);
+  }
+
+  t_mapped_file::t_mapped_file(x_mapped_file file)
+    : data_{utility::reset(file.data_)}, size_{utility::reset(file.size_)},
+      errn_{file.errn_} {
+  }
+
+  t_mapped_file::~t_mapped_file() {
+    unmap();
+  }
+
+  t_mapped_file::r_mapped_file t_mapped_file::operator=(x_mapped_file file) {
+    unmap();
+    data_ = utility::reset(file.data_);
+    size_ = utility::reset(file.size_);
+    errn_ = file.errn_;
+    return *this;
+  }
+
+  t_errn t_mapped_file::map(t_fd fd, t_advice advice) {
+    unmap();
+    errn_ = 0;
+
+    struct stat info;
+    if (::fstat(get(fd), &info) == -1) {
+      errn_ = errno;
+      return t_errn{errn_};
+    }
+    if (!info.st_size)
+      return t_errn{0};
+
+    auto data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE,
+                       get(fd), 0);
+    if (data == MAP_FAILED) {
+      errn_ = errno;
+      return t_errn{errn_};
+    }
+
+    data_ = (P_cstr_)data;
+    size_ = info.st_size;
+    if (advice != ADVICE_NORMAL)
+      ::madvise(data, size_, mk_advice_(advice));
+    return t_errn{0};
+  }
+
+  t_errn t_mapped_file::map(P_cstr path, t_advice advice) {
+    unmap();
+    auto fd = ::open(get(path), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      errn_ = errno;
+      return t_errn{errn_};
+    }
+    map(t_fd{fd}, advice);
+    ::close(fd); // the mapping keeps its own reference
+    return t_errn{errn_};
+  }
+
+  t_void t_mapped_file::unmap() {
+    if (data_)
+      ::munmap((p_void)data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  t_errn t_mapped_file::advise(t_advice advice) {
+    return advise(advice, t_ix{0}, t_n{size_});
+  }
+
+  t_errn t_mapped_file::advise(t_advice advice, t_ix begin, t_n n) {
+    if (get(begin) + get(n) > size_)
+      assert_now(P_cstr("mapped file: advise out of range"));
+    if (!get(n))
+      return t_errn{0};
+
+    // madvise wants a page aligned start.
+    const t_n_ page  = ::sysconf(_SC_PAGESIZE);
+    const t_n_ start = get(begin) - get(begin)%page;
+    if (::madvise((p_void)(data_ + start), get(begin) + get(n) - start,
+                  mk_advice_(advice)) == -1)
+      return t_errn{errno};
+    return t_errn{0};
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,184 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_FILE_H_
+#define _DAINTY_NAMED_FILE_H_
+
+// file: a read-only memory mapping of a whole file, seen as a t_crange.
+//
+//   the file is mapped once and the pages are faulted in by the kernel as
+//   they are touched, so parsing never copies through read(). the advice
+//   tells the kernel how the mapping will be walked:
+//
+//     ADVICE_SEQUENTIAL - aggressive read-ahead, pages dropped behind.
+//     ADVICE_RANDOM     - no read-ahead.
+//     ADVICE_WILLNEED   - start reading the whole range now.
+//
+//   mk_lines() iterates the lines lazily, a line is a t_crange without its
+//   '\n'. the newline is found with memchr, which is vectorized by libc.
+//   all ranges stay valid as long as the t_mapped_file is mapped.
+
+#include "dainty_named_string_impl.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace file
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  using named::t_void;
+  using named::t_bool;
+  using named::t_n_;
+  using named::t_n;
+  using named::t_ix;
+  using named::t_fd;
+  using named::t_errn;
+  using named::P_cstr;
+  using named::P_cstr_;
+  using string::t_crange;
+
+  enum t_advice {
+    ADVICE_NORMAL,
+    ADVICE_SEQUENTIAL,
+    ADVICE_RANDOM,
+    ADVICE_WILLNEED
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_line_iter {
+  public:
+    t_line_iter(P_cstr_ begin, P_cstr_ end) : begin_{begin}, end_{end} {
+      find_();
+    }
+
+    t_crange operator*() const {
+      return t_crange{begin_, t_n{(t_n_)(next_ - begin_)}};
+    }
+
+    t_line_iter& operator++() {
+      begin_ = next_ == end_ ? end_ : next_ + 1;
+      find_();
+      return *this;
+    }
+
+    t_bool operator==(const t_line_iter& iter) const {
+      return begin_ == iter.begin_;
+    }
+
+    t_bool operator!=(const t_line_iter& iter) const {
+      return begin_ != iter.begin_;
+    }
+
+  private:
+    t_void find_();
+
+    P_cstr_ begin_;
+    P_cstr_ end_;
+    P_cstr_ next_ = nullptr;
+  };
+
+  class t_lines {
+  public:
+    t_lines(P_cstr_ begin, P_cstr_ end) : begin_{begin}, end_{end} {
+    }
+
+    t_line_iter begin() const { return t_line_iter{begin_, end_}; }
+    t_line_iter end()   const { return t_line_iter{end_,   end_}; }
+
+  private:
+    P_cstr_ begin_;
+    P_cstr_ end_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_mapped_file {
+  public:
+    using r_mapped_file = t_prefix<t_mapped_file>::r_;
+    using x_mapped_file = t_prefix<t_mapped_file>::x_;
+
+     t_mapped_file() = default;
+     t_mapped_file(t_fd,   t_advice = ADVICE_SEQUENTIAL);
+     t_mapped_file(P_cstr, t_advice = ADVICE_SEQUENTIAL);
+     t_mapped_file(x_mapped_file);
+    ~t_mapped_file();
+
+    t_mapped_file(const t_mapped_file&)           = delete;
+    r_mapped_file operator=(const t_mapped_file&) = delete;
+
+    r_mapped_file operator=(x_mapped_file);
+
+    t_errn map  (t_fd,   t_advice = ADVICE_SEQUENTIAL);
+    t_errn map  (P_cstr, t_advice = ADVICE_SEQUENTIAL);
+    t_void unmap();
+
+    t_errn advise(t_advice);
+    t_errn advise(t_advice, t_ix begin, t_n);
+
+    operator t_validity() const { return errn_ ? INVALID : VALID; }
+    t_errn   get_errn  () const { return t_errn{errn_}; }
+    t_n      get_size  () const { return t_n{size_}; }
+    t_bool   is_empty  () const { return !size_; }
+
+    t_crange mk_range() const;
+    t_lines  mk_lines() const;
+
+    template<class F> t_void each_line(F) const;
+
+  private:
+    P_cstr_  data_ = nullptr;
+    t_n_     size_ = 0;
+    t_errn_  errn_ = 0;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  inline
+  t_crange t_mapped_file::mk_range() const {
+    return t_crange{data_, t_n{size_}};
+  }
+
+  inline
+  t_lines t_mapped_file::mk_lines() const {
+    return t_lines{data_, data_ + size_};
+  }
+
+  template<class F>
+  inline
+  t_void t_mapped_file::each_line(F f) const {
+    for (auto line : mk_lines())
+      f(line);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
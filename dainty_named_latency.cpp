@@ -0,0 +1,136 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include "dainty_named_latency.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace latency
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    std::atomic<t_ix_> next_shard_{0};
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_ix_ get_shard_ix_() {
+    static thread_local t_ix_ ix_ =
+      next_shard_.fetch_add(1, std::memory_order_relaxed) % SHARDS_;
+    return ix_;
+  }
+
+  p_latency_shard_ add_shard_(std::atomic<p_latency_shard_>& slot) {
+    p_latency_shard_ shard = new t_latency_shard_;
+    p_latency_shard_ found = nullptr;
+    if (slot.compare_exchange_strong(found, shard, std::memory_order_acq_rel))
+      return shard;
+    delete shard;
+    return found;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_nsec get_percentile(R_latency_stats stats, t_double percentile) {
+    if (!stats.count)
+      return t_nsec{0};
+    if (percentile >= 100.0)
+      return t_nsec{stats.max};
+
+    t_uint64 want = (t_uint64)(percentile/100.0*stats.count + 0.5);
+    if (!want)
+      want = 1;
+    t_uint64 seen = 0;
+    for (t_ix_ ix = 0; ix < BUCKETS_; ++ix) {
+      seen += stats.buckets[ix];
+      if (seen >= want) {
+        auto value = get_bucket_value_(ix) + get_bucket_width_(ix) - 1;
+        if (value > stats.max)
+          value = stats.max;
+        if (value < stats.min)
+          value = stats.min;
+        return t_nsec{value};
+      }
+    }
+    return t_nsec{stats.max};
+  }
+
+  t_nsec get_mean(R_latency_stats stats) {
+    return t_nsec{stats.count ? stats.sum/stats.count : 0};
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_latency::~t_latency() {
+    for (auto& slot : shards_)
+      delete slot.load(std::memory_order_relaxed);
+  }
+
+  t_latency_stats t_latency::get_stats() const {
+    t_latency_stats stats;
+    t_uint64 min = ~(t_uint64)0;
+    for (auto& slot : shards_) {
+      auto shard = slot.load(std::memory_order_acquire);
+      if (!shard)
+        continue;
+      for (t_ix_ ix = 0; ix < BUCKETS_; ++ix) {
+        auto n = shard->buckets[ix].load(std::memory_order_relaxed);
+        stats.buckets[ix] += n;
+        stats.count       += n;
+      }
+      stats.sum += shard->sum.load(std::memory_order_relaxed);
+      auto shard_min = shard->min.load(std::memory_order_relaxed);
+      auto shard_max = shard->max.load(std::memory_order_relaxed);
+      if (shard_min < min)
+        min = shard_min;
+      if (shard_max > stats.max)
+        stats.max = shard_max;
+    }
+    stats.min = stats.count ? min : 0;
+    return stats;
+  }
+
+  t_void t_latency::reset() {
+    for (auto& slot : shards_) {
+      auto shard = slot.load(std::memory_order_acquire);
+      if (!shard)
+        continue;
+      for (auto& bucket : shard->buckets)
+        bucket.store(0, std::memory_order_relaxed);
+      shard->sum.store(0, std::memory_order_relaxed);
+      shard->min.store(~(t_uint64)0, std::memory_order_relaxed);
+      shard->max.store(0, std::memory_order_relaxed);
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
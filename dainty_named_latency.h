@@ -0,0 +1,227 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_LATENCY_H_
+#define _DAINTY_NAMED_LATENCY_H_
+
+// latency: hdr style histograms of durations in t_nsec.
+//
+//   t_latency records a duration in a handful of instructions: the bucket
+//   is found from the position of the highest set bit and the 5 bits below
+//   it, so every bucket is at most 1/32 of its value wide (about 3%
+//   relative error) from 32 ns up to 2^40 ns (18 minutes). longer
+//   durations are counted in the last bucket, max stays exact.
+//
+//   each thread records into one of 16 shards, created on its first use,
+//   with relaxed atomic adds. get_stats() folds the shards into a
+//   t_latency_stats without stopping the writers.
+//
+//     t_latency latency;
+//     {
+//       t_latency_timer timer{latency};
+//       do_work();
+//     }
+//     string::t_string<TAG, 256> str;
+//     append_latency_stats(str, latency.get_stats());
+
+#include <atomic>
+#include "dainty_named_clock.h"
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace latency
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  constexpr t_n_ SUB_BITS_ = 5;
+  constexpr t_n_ SUB_      = 1 << SUB_BITS_;
+  constexpr t_n_ MAX_BITS_ = 40;
+  constexpr t_n_ BUCKETS_  = (MAX_BITS_ - SUB_BITS_ + 1)*SUB_;
+  constexpr t_n_ SHARDS_   = 16;
+
+  inline
+  t_ix_ get_bucket_(t_uint64 nsec) {
+    if (nsec < SUB_)
+      return nsec;
+    if (nsec >> MAX_BITS_)
+      return BUCKETS_ - 1;
+    t_n_ bits = 63 - __builtin_clzll(nsec) - SUB_BITS_ + 1;
+    return bits*SUB_ + (nsec >> (bits - 1)) - SUB_;
+  }
+
+  // smallest value counted in bucket ix.
+  inline
+  t_uint64 get_bucket_value_(t_ix_ ix) {
+    if (ix < SUB_)
+      return ix;
+    t_n_ bits = ix/SUB_;
+    return (t_uint64)(SUB_ + ix%SUB_) << (bits - 1);
+  }
+
+  inline
+  t_uint64 get_bucket_width_(t_ix_ ix) {
+    return ix < SUB_ ? 1 : (t_uint64)1 << (ix/SUB_ - 1);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_latency_stats {
+    t_uint64 count = 0;
+    t_uint64 sum   = 0;                 // nsec, for the mean
+    t_uint64 min   = 0;                 // nsec
+    t_uint64 max   = 0;                 // nsec
+    t_uint64 buckets[BUCKETS_] = {};
+  };
+  using r_latency_stats = t_prefix<t_latency_stats>::r_;
+  using R_latency_stats = t_prefix<t_latency_stats>::R_;
+
+  // the largest duration of the bucket holding the given percentile
+  // (0 to 100), limited to [min, max].
+  t_nsec get_percentile(R_latency_stats, t_double percentile);
+  t_nsec get_mean      (R_latency_stats);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_latency_shard_ {
+    std::atomic<t_uint64> buckets[BUCKETS_] = {};
+    std::atomic<t_uint64> sum {0};
+    std::atomic<t_uint64> min {~(t_uint64)0};
+    std::atomic<t_uint64> max {0};
+  };
+  using p_latency_shard_ = t_prefix<t_latency_shard_>::p_;
+
+  t_ix_            get_shard_ix_();
+  p_latency_shard_ add_shard_(std::atomic<p_latency_shard_>&);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_latency {
+  public:
+    using r_latency = t_prefix<t_latency>::r_;
+
+     t_latency() = default;
+    ~t_latency();
+
+    t_latency(const t_latency&)           = delete;
+    r_latency operator=(const t_latency&) = delete;
+
+    t_void record(t_nsec);
+    t_void record(t_ticks);             // a duration, not a timestamp
+
+    t_latency_stats get_stats() const;
+
+    // not atomic with respect to concurrent record calls.
+    t_void reset();
+
+  private:
+    std::atomic<p_latency_shard_> shards_[SHARDS_] = {};
+  };
+  using r_latency = t_latency::r_latency;
+
+  inline
+  t_void t_latency::record(t_nsec nsec) {
+    auto& slot  = shards_[get_shard_ix_()];
+    auto  shard = slot.load(std::memory_order_acquire);
+    if (__builtin_expect(!shard, 0))
+      shard = add_shard_(slot);
+
+    auto value = get(nsec);
+    shard->buckets[get_bucket_(value)].fetch_add(1, std::memory_order_relaxed);
+    shard->sum.fetch_add(value, std::memory_order_relaxed);
+
+    auto min = shard->min.load(std::memory_order_relaxed);
+    while (value < min &&
+           !shard->min.compare_exchange_weak(min, value,
+                                             std::memory_order_relaxed))
+      ;
+    auto max = shard->max.load(std::memory_order_relaxed);
+    while (value > max &&
+           !shard->max.compare_exchange_weak(max, value,
+                                             std::memory_order_relaxed))
+      ;
+  }
+
+  inline
+  t_void t_latency::record(t_ticks ticks) {
+    record(clock::to_nsec(ticks));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // records the time from construction to destruction.
+  class t_latency_timer {
+  public:
+    using r_latency_timer = t_prefix<t_latency_timer>::r_;
+
+    inline
+    t_latency_timer(r_latency latency)
+      : latency_(latency), begin_(clock::get_ticks()) {
+    }
+
+    inline
+    ~t_latency_timer() {
+      latency_.record(t_ticks{get(clock::get_ticks()) - get(begin_)});
+    }
+
+    t_latency_timer(const t_latency_timer&)           = delete;
+    r_latency_timer operator=(const t_latency_timer&) = delete;
+
+  private:
+    r_latency latency_;
+    t_ticks   begin_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // "count 1000 min 120 mean 340 p50 310 p90 450 p99 900 p99.9 2100
+  //  max 9000 ns", follows the overflow policy of the t_string.
+  template<class TAG, t_n_ N, class I>
+  inline
+  string::t_string<TAG, N, I>&
+      append_latency_stats(string::t_string<TAG, N, I>& str,
+                           R_latency_stats stats) {
+    using t_ull_ = unsigned long long;
+    return str.append(string::FMT,
+      "count %llu min %llu mean %llu p50 %llu p90 %llu p99 %llu "
+      "p99.9 %llu max %llu ns",
+      (t_ull_)stats.count, (t_ull_)stats.min,
+      (t_ull_)get(get_mean(stats)),
+      (t_ull_)get(get_percentile(stats, 50.0)),
+      (t_ull_)get(get_percentile(stats, 90.0)),
+      (t_ull_)get(get_percentile(stats, 99.0)),
+      (t_ull_)get(get_percentile(stats, 99.9)),
+      (t_ull_)stats.max);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -24,6 +24,9 @@
 
 ******************************************************************************/
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 #include "dainty_named_assert.h"
 #include "dainty_named_range.h"
 
@@ -35,31 +38,38 @@ namespace range
 {
 ///////////////////////////////////////////////////////////////////////////////
 
-  t_void check_(t_n_ n, t_ix_ begin) {
-    if (begin >= n)
+  // an empty range is valid, with or without a pointer.
+  t_void check_(P_void item, t_n_ n) {
+    if (!item && n)
+      assert_now(P_cstr{"range: init error"});
+  }
+
+  t_void check_(P_void item, t_n_ n, t_ix_ ix) {
+    if (!item)
+      assert_now(P_cstr{"range: invalid range"});
+    if (ix >= n)
       assert_now(P_cstr{"range: overflow 1"});
   }
 
-  t_void check_(t_n_ n, t_ix_ begin, t_ix_ end) {
-    if (begin >= n || begin >= end || end - begin >= n)
-      assert_now(P_cstr{"range: overflow 2"});
+  // a slice may be empty, like the range it is cut from.
+  t_void check_slice_(t_n_ n, t_ix_ begin) {
+    if (begin > n)
+      assert_now(P_cstr{"range: overflow 1"});
   }
 
-  t_void check_(P_void item, t_n_ n) {
-    if (!item || !n)
-      assert_now(P_cstr{"range: init error"});
+  t_void check_slice_(t_n_ n, t_ix_ begin, t_ix_ end) {
+    if (begin > end || end > n)
+      assert_now(P_cstr{"range: overflow 2"});
   }
 
-  t_void check_(P_void item, t_n_ n, t_ix_ begin) {
-    if (!item)
-      assert_now(P_cstr{"range: invalid range"});
-    check_(n, begin);
+  t_void check_slice_(P_void item, t_n_ n, t_ix_ begin) {
+    check_(item, n);
+    check_slice_(n, begin);
   }
 
-  t_void check_(P_void item, t_n_ n, t_ix_ begin, t_ix_ end) {
-    if (!item)
-      assert_now(P_cstr{"range: invalid range"});
-    check_(n, begin, end);
+  t_void check_slice_(P_void item, t_n_ n, t_ix_ begin, t_ix_ end) {
+    check_(item, n);
+    check_slice_(n, begin, end);
   }
 
   t_void check_(P_void item1, t_n_ n1, P_void item2, t_n_ n2) {
@@ -69,6 +79,40 @@ namespace range
     check_(item2, n2);
   }
 
+///////////////////////////////////////////////////////////////////////////////
+
+  t_void copy_stream_(p_void dst, P_void src, t_n_ bytes) {
+#if defined(__SSE2__)
+    auto d = (p_uchar)dst;
+    auto s = (P_uchar)src;
+    if (d < s + bytes && s < d + bytes) { // overlap, streaming is forward
+      std::memmove(dst, src, bytes);
+      return;
+    }
+
+    t_n_ head = (16 - ((std::uintptr_t)d & 15)) & 15;
+    std::memcpy(d, s, head);
+    d += head;
+    s += head;
+    bytes -= head;
+
+    for (; bytes >= 64; d += 64, s += 64, bytes -= 64) {
+      auto a = _mm_loadu_si128((const __m128i*)s);
+      auto b = _mm_loadu_si128((const __m128i*)(s + 16));
+      auto c = _mm_loadu_si128((const __m128i*)(s + 32));
+      auto e = _mm_loadu_si128((const __m128i*)(s + 48));
+      _mm_stream_si128((__m128i*)d,        a);
+      _mm_stream_si128((__m128i*)(d + 16), b);
+      _mm_stream_si128((__m128i*)(d + 32), c);
+      _mm_stream_si128((__m128i*)(d + 48), e);
+    }
+    _mm_sfence();
+    std::memcpy(d, s, bytes);
+#else
+    std::memmove(dst, src, bytes);
+#endif
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
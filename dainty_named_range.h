@@ -27,9 +27,47 @@
 #ifndef _DAINTY_NAMED_RANGE_H_
 #define _DAINTY_NAMED_RANGE_H_
 
+#include <cstring>
+#include <type_traits>
 #include "dainty_named.h"
 
-// DAINTY_NAMED_RANGE_CHECK
+#ifndef DAINTY_NAMED_RANGE_CHECK_LEVEL
+#ifdef DAINTY_NAMED_RANGE_CHECK
+#define DAINTY_NAMED_RANGE_CHECK_LEVEL 2
+#else
+#define DAINTY_NAMED_RANGE_CHECK_LEVEL 0
+#endif
+#endif
+
+// every range TAG has a check tier, fixed at compile time:
+//
+//   RANGE_CHECK_OFF   - no checks.
+//   RANGE_CHECK_HOIST - a range is checked where it is made: construction,
+//                       mk_range/mk_crange slices and assignment. item
+//                       access (operator[], get) and each() are not, so a
+//                       loop over a view that was checked once pays nothing
+//                       per item.
+//   RANGE_CHECK_FULL  - item access is checked too.
+//
+// DAINTY_NAMED_RANGE_CHECK_LEVEL sets the tier of all TAGs (0, 1 or 2). it
+// defaults to RANGE_CHECK_FULL when DAINTY_NAMED_RANGE_CHECK is defined
+// and to RANGE_CHECK_OFF otherwise. a TAG gets its own tier with a
+// specialization, e.g. to keep checking ranges over external input:
+//
+//   template<>
+//   struct t_range_check_tier<t_input_tag> {
+//     static constexpr t_range_check TIER = RANGE_CHECK_FULL;
+//   };
+//
+// a slice is checked when the tier of either its source or its TAG asks
+// for it. an empty range (an empty line, field or file) is valid, its
+// pointer may be null. so is an empty slice: begin may equal the size,
+// end may equal begin. item access still needs ix below the size.
+//
+// copy-assignment of trivially copyable items is a memmove, copies of at
+// least COPY_STREAM_BYTES_ use non-temporal stores instead, so that a big
+// buffer copy does not evict the cache. equality of integral, enum,
+// pointer and t_explicit items of those is a memcmp.
 
 namespace dainty
 {
@@ -48,11 +86,83 @@ namespace range
   using named::VALID;
   using named::INVALID;
 
+///////////////////////////////////////////////////////////////////////////////
+
+  enum t_range_check {
+    RANGE_CHECK_OFF   = 0,
+    RANGE_CHECK_HOIST = 1,
+    RANGE_CHECK_FULL  = 2
+  };
+
+  constexpr t_range_check RANGE_CHECK_LEVEL_ =
+    (t_range_check)DAINTY_NAMED_RANGE_CHECK_LEVEL;
+
+  template<typename TAG>
+  struct t_range_check_tier {
+    static constexpr t_range_check TIER = RANGE_CHECK_LEVEL_;
+  };
+
+  template<t_range_check TIER, typename TAG>
+  constexpr
+  t_bool is_range_check_on() {
+    return TIER <= t_range_check_tier<TAG>::TIER;
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 
   template<typename T, typename TAG>
   class t_crange;
 
+///////////////////////////////////////////////////////////////////////////////
+
+  // items that are equal exactly when their bytes are.
+  template<typename T>
+  struct t_is_bitwise_equal_ {
+    static constexpr t_bool value = std::is_integral<T>::value ||
+                                    std::is_enum<T>::value ||
+                                    std::is_pointer<T>::value;
+  };
+
+  template<typename T, typename TAG, typename V>
+  struct t_is_bitwise_equal_<t_explicit<T, TAG, V>> {
+    static constexpr t_bool value = t_is_bitwise_equal_<T>::value;
+  };
+
+  constexpr t_n_ COPY_STREAM_BYTES_ = 4 << 20;
+
+  t_void copy_stream_(p_void, P_void, t_n_);
+
+  template<typename T>
+  inline
+  t_void copy_(T* dst, const T* src, t_n_ n) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+      const t_n_ bytes = n*sizeof(T);
+      if (bytes >= COPY_STREAM_BYTES_)
+        copy_stream_(dst, src, bytes);
+      else if (bytes)
+        std::memmove(dst, src, bytes);
+    } else {
+      for (t_n_ i = 0; i < n; ++i)
+        dst[i] = src[i];
+    }
+  }
+
+  template<typename T>
+  inline
+  t_bool is_equal_(const T* lh, const T* rh, t_n_ n) {
+    if constexpr (t_is_bitwise_equal_<T>::value) {
+      return !n || !std::memcmp(lh, rh, n*sizeof(T));
+    } else {
+      t_n_ i = 0;
+      for (; i < n; ++i)
+        if (lh[i] != rh[i])
+          break;
+      return i == n;
+    }
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
   template<typename T, typename TAG>
   class t_range {
   public:
@@ -169,13 +279,8 @@ namespace range
   inline
   t_bool operator==(t_crange<T, TAG> lh, t_crange<T, TAG> rh) {
     if (lh.n == rh.n) {
-      if (lh.ptr != rh.ptr) {
-        t_n_ i = 0, n = get(lh.n);
-        for (; i < n; ++i)
-          if (lh.ptr[i] != rh.ptr[i])
-            break;
-        return i == n;
-      }
+      if (lh.ptr != rh.ptr)
+        return is_equal_(lh.ptr, rh.ptr, get(lh.n));
       return true;
     }
     return false;
@@ -227,12 +332,13 @@ namespace range
 
 ///////////////////////////////////////////////////////////////////////////////
 
-  t_void check_(        t_n_, t_ix_);
-  t_void check_(        t_n_, t_ix_, t_ix_);
-  t_void check_(P_void, t_n_);
-  t_void check_(P_void, t_n_, t_ix_);
-  t_void check_(P_void, t_n_, t_ix_, t_ix_);
-  t_void check_(P_void, t_n_, P_void, t_n_);
+  t_void check_      (P_void, t_n_);
+  t_void check_      (P_void, t_n_, t_ix_);
+  t_void check_      (P_void, t_n_, P_void, t_n_);
+  t_void check_slice_(        t_n_, t_ix_);
+  t_void check_slice_(        t_n_, t_ix_, t_ix_);
+  t_void check_slice_(P_void, t_n_, t_ix_);
+  t_void check_slice_(P_void, t_n_, t_ix_, t_ix_);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -257,9 +363,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_range<T, TAG> mk_range(T (&arr)[N], t_ix begin) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin));
     const auto n = N - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -267,9 +372,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_crange<T, TAG> mk_crange(T (&arr)[N], t_ix begin) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin));
     const auto n = N - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -277,9 +381,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_crange<T, TAG> mk_crange(const T (&arr)[N], t_ix begin) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin));
     const auto n = N - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -287,9 +390,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_range<T, TAG> mk_range(T (&arr)[N], t_ix begin, t_ix end) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin), get(end));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin), get(end));
     const auto n = get(end) - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -297,9 +399,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_crange<T, TAG> mk_crange(T (&arr)[N], t_ix begin, t_ix end) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin), get(end));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin), get(end));
     const auto n = get(end) - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -307,9 +408,8 @@ namespace range
   template<typename TAG, typename T, t_n_ N>
   inline
   t_crange<T, TAG> mk_crange(const T (&arr)[N], t_ix begin, t_ix end) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(N, get(begin), get(end));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_slice_(N, get(begin), get(end));
     const auto n = get(end) - get(begin);
     return {arr + get(begin), t_n{n}};
   }
@@ -331,9 +431,9 @@ namespace range
   template<typename TAG1, typename TAG, typename T>
   inline
   t_range<T, TAG1> mk_range(t_range<T, TAG> range, t_ix begin) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(range.ptr, get(range.n), get(begin));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check_slice_(range.ptr, get(range.n), get(begin));
     const auto n = get(range.n) - get(begin);
     return {range.ptr + get(begin), t_n{n}};
   }
@@ -341,9 +441,9 @@ namespace range
   template<typename TAG1, typename TAG, typename T>
   inline
   t_crange<T, TAG1> mk_crange(t_crange<T, TAG> range, t_ix begin) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(range.ptr, get(range.n), get(begin));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check_slice_(range.ptr, get(range.n), get(begin));
     const auto n = get(range.n) - get(begin);
     return {range.ptr + get(begin), t_n{n}};
   }
@@ -351,9 +451,9 @@ namespace range
   template<typename TAG1, typename TAG, typename T>
   inline
   t_range<T, TAG1> mk_range(t_range<T, TAG> range, t_ix begin, t_ix end) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(range.ptr, get(range.n), get(begin), get(end));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check_slice_(range.ptr, get(range.n), get(begin), get(end));
     const auto n = get(end) - get(begin);
     return {range.ptr + get(begin), t_n{n}};
   }
@@ -361,9 +461,9 @@ namespace range
   template<typename TAG1, typename TAG, typename T>
   inline
   t_crange<T, TAG1> mk_crange(t_crange<T, TAG> range, t_ix begin, t_ix end) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(range.ptr, get(range.n), get(begin), get(end));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check_slice_(range.ptr, get(range.n), get(begin), get(end));
     const auto n = get(end) - get(begin);
     return {range.ptr + get(begin), t_n{n}};
   }
@@ -373,68 +473,57 @@ namespace range
   template<typename T, typename TAG>
   inline
   t_range<T, TAG>::t_range(p_item _ptr, t_n _n) : ptr{_ptr}, n{_n} {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(ptr, named::get(n));
   }
 
   template<typename T, typename TAG>
   inline
   t_range<T, TAG>& t_range<T, TAG>::operator=(const t_range<T, TAG>& range) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), range.ptr, named::get(range.n));
-#endif
-    auto n = named::get(range.n);
-    for (t_n_ i = 0; i < n; ++i)
-      ptr[i] = range.ptr[i];
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(ptr, named::get(n), range.ptr, named::get(range.n));
+    copy_(ptr, range.ptr, named::get(range.n));
     return *this;
   }
 
   template<typename T, typename TAG>
   inline
   t_range<T, TAG>& t_range<T, TAG>::operator=(const t_crange<T, TAG>& range) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), range.ptr, named::get(range.n));
-#endif
-    auto n = named::get(range.n);
-    for (t_n_ i = 0; i < n; ++i)
-      ptr[i] = range.ptr[i];
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(ptr, named::get(n), range.ptr, named::get(range.n));
+    copy_(ptr, range.ptr, named::get(range.n));
     return *this;
   }
 
   template<typename T, typename TAG>
   inline
   typename t_range<T, TAG>::r_item t_range<T, TAG>::operator[](t_ix ix) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr[named::get(ix)];
   }
 
   template<typename T, typename TAG>
   inline
   typename t_range<T, TAG>::R_item t_range<T, TAG>::operator[](t_ix ix) const {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr[named::get(ix)];
   }
 
   template<typename T, typename TAG>
   inline
   typename t_range<T, TAG>::p_item t_range<T, TAG>::get(t_ix ix) {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr + named::get(ix);
   }
 
   template<typename T, typename TAG>
   inline
   typename t_range<T, TAG>::P_item t_range<T, TAG>::get(t_ix ix) const {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr + named::get(ix);
   }
 
@@ -479,9 +568,8 @@ namespace range
   template<typename T, typename TAG>
   inline
   t_crange<T, TAG>::t_crange(P_item _ptr, t_n _n) : ptr{_ptr}, n{_n} {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(_ptr, named::get(n));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(_ptr, named::get(n));
   }
 
   template<typename T, typename TAG>
@@ -494,18 +582,16 @@ namespace range
   inline
   typename t_crange<T, TAG>::R_item
       t_crange<T, TAG>::operator[](t_ix ix) const {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr[named::get(ix)];
   }
 
   template<typename T, typename TAG>
   inline
   typename t_crange<T, TAG>::P_item t_crange<T, TAG>::get(t_ix ix) const {
-#ifdef DAINTY_NAMED_RANGE_CHECK
-    check_(ptr, named::get(n), named::get(ix));
-#endif
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check_(ptr, named::get(n), named::get(ix));
     return ptr + named::get(ix);
   }
 
@@ -0,0 +1,462 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_RANGE2D_H_
+#define _DAINTY_NAMED_RANGE2D_H_
+
+// range2d: a rows x cols view on items laid out row after row, with a row
+// stride (in items) that can be larger than cols.
+//
+//   mk_range2d() makes a sub-view (a block of rows and columns) without
+//   copying, it keeps the stride of the view it is cut from.
+//
+//   each_tile() walks the view in square tiles of get_tile_edge_<T>()
+//   items (16 KiB of items per tile), so that a tile and what it is
+//   combined with stay in the l1 cache. transpose() uses it: a naive
+//   transpose walks one side by column and misses the cache on every item.
+//
+//   assigning a t_crange2d to a t_range2d copies row by row, with the
+//   memmove fast path of t_range.
+//
+//   views and get_row() are checked at the RANGE_CHECK_HOIST tier of their
+//   TAG, operator() and get() at RANGE_CHECK_FULL.
+
+#include "dainty_named_assert.h"
+#include "dainty_named_range.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  // largest power of 2 with edge*edge items in 16 KiB, at least 8.
+  template<typename T>
+  constexpr t_n_ get_tile_edge_() {
+    t_n_ edge = 8;
+    while ((2*edge)*(2*edge)*sizeof(T) <= 16384)
+      edge *= 2;
+    return edge;
+  }
+
+  inline
+  t_void check2d_(t_n_ rows, t_n_ cols, t_ix_ row, t_ix_ col, t_n_ n_rows,
+                  t_n_ n_cols) {
+    if (row > rows || n_rows > rows - row || col > cols ||
+        n_cols > cols - col)
+      assert_now(P_cstr{"range2d: out of range"});
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG>
+  class t_crange2d;
+
+  template<typename T, typename TAG>
+  class t_range2d {
+  public:
+    using t_tag  = TAG;
+    using t_item = T;
+    using r_item = typename t_prefix<T>::r_;
+    using R_item = typename t_prefix<T>::R_;
+    using p_item = typename t_prefix<T>::p_;
+    using P_item = typename t_prefix<T>::P_;
+
+    t_range2d(p_item, t_n rows, t_n cols);
+    t_range2d(p_item, t_n rows, t_n cols, t_n stride);
+
+    t_range2d& operator=(const t_range2d<T, TAG>&);
+    t_range2d& operator=(const t_crange2d<T, TAG>&);
+
+    operator t_validity() const;
+
+    r_item operator()(t_ix row, t_ix col);
+    R_item operator()(t_ix row, t_ix col) const;
+
+    p_item get(t_ix row, t_ix col);
+    P_item get(t_ix row, t_ix col) const;
+
+    t_range<T, TAG> get_row(t_ix row) const;
+
+    template<typename F> t_void  each(F);
+    template<typename F> t_void ceach(F) const;
+
+    // f(t_range2d tile, t_ix row, t_ix col) for every tile, row by row.
+    template<typename F> t_void each_tile(F) const;
+    template<typename F> t_void each_tile(t_n edge, F) const;
+
+    p_item const ptr;
+    const t_n    rows;
+    const t_n    cols;
+    const t_n    stride;
+  };
+
+  template<typename T, typename TAG>
+  class t_crange2d {
+  public:
+    using t_tag  = TAG;
+    using t_item = T;
+    using R_item = typename t_prefix<T>::R_;
+    using P_item = typename t_prefix<T>::P_;
+
+    t_crange2d(P_item, t_n rows, t_n cols);
+    t_crange2d(P_item, t_n rows, t_n cols, t_n stride);
+    t_crange2d(const t_range2d<T, TAG>&);
+
+    operator t_validity() const;
+
+    R_item operator()(t_ix row, t_ix col) const;
+
+    P_item get(t_ix row, t_ix col) const;
+
+    t_crange<T, TAG> get_row(t_ix row) const;
+
+    template<typename F> t_void ceach(F) const;
+
+    // f(t_crange2d tile, t_ix row, t_ix col) for every tile, row by row.
+    template<typename F> t_void each_tile(F) const;
+    template<typename F> t_void each_tile(t_n edge, F) const;
+
+    P_item const ptr;
+    const t_n    rows;
+    const t_n    cols;
+    const t_n    stride;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename TAG1, typename TAG, typename T>
+  inline
+  t_range2d<T, TAG1> mk_range2d(t_range2d<T, TAG> range, t_ix row, t_ix col,
+                                t_n rows, t_n cols) {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check2d_(get(range.rows), get(range.cols), get(row), get(col), get(rows),
+               get(cols));
+    return {range.ptr + get(row)*get(range.stride) + get(col), rows, cols,
+            range.stride};
+  }
+
+  template<typename TAG1, typename TAG, typename T>
+  inline
+  t_crange2d<T, TAG1> mk_crange2d(t_crange2d<T, TAG> range, t_ix row,
+                                  t_ix col, t_n rows, t_n cols) {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>() ||
+                  is_range_check_on<RANGE_CHECK_HOIST, TAG1>())
+      check2d_(get(range.rows), get(range.cols), get(row), get(col), get(rows),
+               get(cols));
+    return {range.ptr + get(row)*get(range.stride) + get(col), rows, cols,
+            range.stride};
+  }
+
+  template<typename TAG, typename T, t_n_ ROWS, t_n_ COLS>
+  inline
+  t_range2d<T, TAG> mk_range2d(T (&arr)[ROWS][COLS]) {
+    return {&arr[0][0], t_n{ROWS}, t_n{COLS}};
+  }
+
+  template<typename TAG, typename T, t_n_ ROWS, t_n_ COLS>
+  inline
+  t_crange2d<T, TAG> mk_crange2d(const T (&arr)[ROWS][COLS]) {
+    return {&arr[0][0], t_n{ROWS}, t_n{COLS}};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // walks [0, rows) x [0, cols) in edge x edge tiles, f(row, col, rows,
+  // cols) gets the corner and size of each.
+  template<typename F>
+  inline
+  t_void each_tile_(t_n_ rows, t_n_ cols, t_n_ edge, F f) {
+    for (t_ix_ row = 0; row < rows; row += edge) {
+      const t_n_ n_rows = rows - row < edge ? rows - row : edge;
+      for (t_ix_ col = 0; col < cols; col += edge)
+        f(row, col, n_rows, cols - col < edge ? cols - col : edge);
+    }
+  }
+
+  // dst(col, row) = src(row, col), dst must be cols x rows of src.
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void transpose(t_crange2d<T, TAG> src, t_range2d<T, TAG1> dst) {
+    if (get(dst.rows) != get(src.cols) || get(dst.cols) != get(src.rows))
+      assert_now(P_cstr{"range2d: not transposed size"});
+    const auto s_ptr = src.ptr, s_stride = get(src.stride);
+    const auto d_ptr = dst.ptr, d_stride = get(dst.stride);
+    each_tile_(get(src.rows), get(src.cols), get_tile_edge_<T>(),
+      [=](t_ix_ row, t_ix_ col, t_n_ rows, t_n_ cols) {
+        for (t_ix_ c = col; c < col + cols; ++c) {
+          auto d = d_ptr + c*d_stride;
+          auto s = s_ptr + c;
+          for (t_ix_ r = row; r < row + rows; ++r)
+            d[r] = s[r*s_stride];
+        }
+      });
+  }
+
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void transpose(t_range2d<T, TAG> src, t_range2d<T, TAG1> dst) {
+    transpose(t_crange2d<T, TAG>{src}, dst);
+  }
+
+  // dst = src, row by row. the shapes must be the same.
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void copy(t_crange2d<T, TAG> src, t_range2d<T, TAG1> dst) {
+    if (get(dst.rows) != get(src.rows) || get(dst.cols) != get(src.cols))
+      assert_now(P_cstr{"range2d: not same size"});
+    const auto rows = get(src.rows), cols = get(src.cols);
+    if (get(src.stride) == cols && get(dst.stride) == cols) {
+      copy_(dst.ptr, src.ptr, rows*cols);
+      return;
+    }
+    for (t_ix_ row = 0; row < rows; ++row)
+      copy_(dst.ptr + row*get(dst.stride), src.ptr + row*get(src.stride),
+            cols);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG>
+  inline
+  t_range2d<T, TAG>::t_range2d(p_item _ptr, t_n _rows, t_n _cols)
+    : ptr{_ptr}, rows{_rows}, cols{_cols}, stride{_cols} {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(ptr, named::get(rows)*named::get(cols));
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_range2d<T, TAG>::t_range2d(p_item _ptr, t_n _rows, t_n _cols,
+                               t_n _stride)
+    : ptr{_ptr}, rows{_rows}, cols{_cols}, stride{_stride} {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>()) {
+      check_(ptr, named::get(rows)*named::get(cols));
+      if (named::get(stride) < named::get(cols))
+        assert_now(P_cstr{"range2d: stride smaller than cols"});
+    }
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_range2d<T, TAG>&
+      t_range2d<T, TAG>::operator=(const t_range2d<T, TAG>& range) {
+    copy(t_crange2d<T, TAG>{range}, *this);
+    return *this;
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_range2d<T, TAG>&
+      t_range2d<T, TAG>::operator=(const t_crange2d<T, TAG>& range) {
+    copy(range, *this);
+    return *this;
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_range2d<T, TAG>::operator t_validity() const {
+    return ptr ? VALID : INVALID;
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_range2d<T, TAG>::r_item
+      t_range2d<T, TAG>::operator()(t_ix row, t_ix col) {
+    return *get(row, col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_range2d<T, TAG>::R_item
+      t_range2d<T, TAG>::operator()(t_ix row, t_ix col) const {
+    return *get(row, col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_range2d<T, TAG>::p_item
+      t_range2d<T, TAG>::get(t_ix row, t_ix col) {
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check2d_(named::get(rows), named::get(cols), named::get(row),
+               named::get(col), 1, 1);
+    return ptr + named::get(row)*named::get(stride) + named::get(col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_range2d<T, TAG>::P_item
+      t_range2d<T, TAG>::get(t_ix row, t_ix col) const {
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check2d_(named::get(rows), named::get(cols), named::get(row),
+               named::get(col), 1, 1);
+    return ptr + named::get(row)*named::get(stride) + named::get(col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_range<T, TAG> t_range2d<T, TAG>::get_row(t_ix row) const {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check2d_(named::get(rows), named::get(cols), named::get(row), 0, 1,
+               named::get(cols));
+    return {ptr + named::get(row)*named::get(stride), cols};
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_range2d<T, TAG>::each(F f) {
+    for (t_ix_ row = 0, n = named::get(rows); row < n; ++row) {
+      auto p = ptr + row*named::get(stride);
+      for (t_ix_ col = 0, m = named::get(cols); col < m; ++col)
+        f(p[col]);
+    }
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_range2d<T, TAG>::ceach(F f) const {
+    t_crange2d<T, TAG>{*this}.ceach(f);
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_range2d<T, TAG>::each_tile(F f) const {
+    each_tile(t_n{get_tile_edge_<T>()}, f);
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_range2d<T, TAG>::each_tile(t_n edge, F f) const {
+    each_tile_(named::get(rows), named::get(cols), named::get(edge),
+      [&](t_ix_ row, t_ix_ col, t_n_ n_rows, t_n_ n_cols) {
+        f(t_range2d{ptr + row*named::get(stride) + col, t_n{n_rows},
+                    t_n{n_cols}, stride}, t_ix{row}, t_ix{col});
+      });
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG>
+  inline
+  t_crange2d<T, TAG>::t_crange2d(P_item _ptr, t_n _rows, t_n _cols)
+    : ptr{_ptr}, rows{_rows}, cols{_cols}, stride{_cols} {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check_(ptr, named::get(rows)*named::get(cols));
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_crange2d<T, TAG>::t_crange2d(P_item _ptr, t_n _rows, t_n _cols,
+                                 t_n _stride)
+    : ptr{_ptr}, rows{_rows}, cols{_cols}, stride{_stride} {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>()) {
+      check_(ptr, named::get(rows)*named::get(cols));
+      if (named::get(stride) < named::get(cols))
+        assert_now(P_cstr{"range2d: stride smaller than cols"});
+    }
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_crange2d<T, TAG>::t_crange2d(const t_range2d<T, TAG>& range)
+    : ptr{range.ptr}, rows{range.rows}, cols{range.cols},
+      stride{range.stride} {
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_crange2d<T, TAG>::operator t_validity() const {
+    return ptr ? VALID : INVALID;
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_crange2d<T, TAG>::R_item
+      t_crange2d<T, TAG>::operator()(t_ix row, t_ix col) const {
+    return *get(row, col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  typename t_crange2d<T, TAG>::P_item
+      t_crange2d<T, TAG>::get(t_ix row, t_ix col) const {
+    if constexpr (is_range_check_on<RANGE_CHECK_FULL, TAG>())
+      check2d_(named::get(rows), named::get(cols), named::get(row),
+               named::get(col), 1, 1);
+    return ptr + named::get(row)*named::get(stride) + named::get(col);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_crange<T, TAG> t_crange2d<T, TAG>::get_row(t_ix row) const {
+    if constexpr (is_range_check_on<RANGE_CHECK_HOIST, TAG>())
+      check2d_(named::get(rows), named::get(cols), named::get(row), 0, 1,
+               named::get(cols));
+    return {ptr + named::get(row)*named::get(stride), cols};
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_crange2d<T, TAG>::ceach(F f) const {
+    for (t_ix_ row = 0, n = named::get(rows); row < n; ++row) {
+      auto p = ptr + row*named::get(stride);
+      for (t_ix_ col = 0, m = named::get(cols); col < m; ++col)
+        f(p[col]);
+    }
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_crange2d<T, TAG>::each_tile(F f) const {
+    each_tile(t_n{get_tile_edge_<T>()}, f);
+  }
+
+  template<typename T, typename TAG>
+  template<typename F>
+  inline
+  t_void t_crange2d<T, TAG>::each_tile(t_n edge, F f) const {
+    each_tile_(named::get(rows), named::get(cols), named::get(edge),
+      [&](t_ix_ row, t_ix_ col, t_n_ n_rows, t_n_ n_cols) {
+        f(t_crange2d{ptr + row*named::get(stride) + col, t_n{n_rows},
+                     t_n{n_cols}, stride}, t_ix{row}, t_ix{col});
+      });
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -0,0 +1,450 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_RANGE_ALGO_H_
+#define _DAINTY_NAMED_RANGE_ALGO_H_
+
+// algo: searching and sorting t_range and t_crange.
+//
+//   lower_bound() and upper_bound() halve the range without a branch on
+//   the comparison (it becomes a conditional move), so the cost no longer
+//   depends on how well the branch predictor guesses the key.
+//
+//   for read-mostly tables, mk_eytzinger() lays a sorted range out as an
+//   implicit binary tree (children of k at 2k and 2k+1, in breadth first
+//   order). eytzinger_lower_bound() then walks it from the root, the next
+//   levels of the path share cache lines and are prefetched.
+//
+//   sort() is a pattern-defeating quicksort: median of 3 (ninther above
+//   128 items) pivots, insertion sort below 24 items, partitions that are
+//   already sorted are detected and finished with a bounded insertion
+//   sort, runs of equal items are split off in one pass, and bad pivots
+//   shuffle the range and eventually fall back to heapsort, so the worst
+//   case stays O(n log n). it is not stable.
+//
+//   the comparator defaults to t_less, which compares t_explicit items by
+//   their value. a comparator is called as cmp(item, key) or
+//   cmp(key, item) and must give a strict weak order.
+
+#include <algorithm>
+#include <utility>
+#include "dainty_named_assert.h"
+#include "dainty_named_range.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  constexpr const T& get_key_(const T& value) {
+    return value;
+  }
+
+  template<typename T, typename TAG, typename V>
+  constexpr T get_key_(const t_explicit<T, TAG, V>& value) {
+    return get(value);
+  }
+
+  struct t_less {
+    template<typename A, typename B>
+    constexpr t_bool operator()(const A& lh, const B& rh) const {
+      return get_key_(lh) < get_key_(rh);
+    }
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  // index of the first item that is not less than key, or n.
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix lower_bound(t_crange<T, TAG> range, const K& key, C cmp = C{}) {
+    const T* base = range.ptr;
+    t_n_     n    = get(range.n);
+    if (!n)
+      return t_ix{0};
+    while (n > 1) {
+      const t_n_ half = n/2;
+      __builtin_prefetch(base + half/2);
+      __builtin_prefetch(base + half + half/2);
+      base = cmp(base[half], key) ? base + half : base;
+      n   -= half;
+    }
+    return t_ix{(t_ix_)(base - range.ptr) + cmp(*base, key)};
+  }
+
+  // index of the first item that is greater than key, or n.
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix upper_bound(t_crange<T, TAG> range, const K& key, C cmp = C{}) {
+    const T* base = range.ptr;
+    t_n_     n    = get(range.n);
+    if (!n)
+      return t_ix{0};
+    while (n > 1) {
+      const t_n_ half = n/2;
+      __builtin_prefetch(base + half/2);
+      __builtin_prefetch(base + half + half/2);
+      base = cmp(key, base[half]) ? base : base + half;
+      n   -= half;
+    }
+    return t_ix{(t_ix_)(base - range.ptr) + !cmp(key, *base)};
+  }
+
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_bool binary_search(t_crange<T, TAG> range, const K& key, C cmp = C{}) {
+    auto ix = get(lower_bound(range, key, cmp));
+    return ix < get(range.n) && !cmp(key, range.ptr[ix]);
+  }
+
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix lower_bound(t_range<T, TAG> range, const K& key, C cmp = C{}) {
+    return lower_bound(t_crange<T, TAG>{range}, key, cmp);
+  }
+
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix upper_bound(t_range<T, TAG> range, const K& key, C cmp = C{}) {
+    return upper_bound(t_crange<T, TAG>{range}, key, cmp);
+  }
+
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_bool binary_search(t_range<T, TAG> range, const K& key, C cmp = C{}) {
+    return binary_search(t_crange<T, TAG>{range}, key, cmp);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  inline
+  t_ix_ mk_eytzinger_(const T* sorted, T* out, t_n_ n, t_ix_ ix, t_ix_ k) {
+    if (k <= n) {
+      ix         = mk_eytzinger_(sorted, out, n, ix, 2*k);
+      out[k - 1] = sorted[ix++];
+      ix         = mk_eytzinger_(sorted, out, n, ix, 2*k + 1);
+    }
+    return ix;
+  }
+
+  // out gets the items of sorted in eytzinger order, both of the same size.
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void mk_eytzinger(t_crange<T, TAG> sorted, t_range<T, TAG1> out) {
+    if (get(sorted.n) != get(out.n))
+      assert_now(P_cstr{"range: not same size"});
+    mk_eytzinger_(sorted.ptr, out.ptr, get(sorted.n), 0, 1);
+  }
+
+  // position in the eytzinger layout of the first item that is not less
+  // than key, or n.
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix eytzinger_lower_bound(t_crange<T, TAG> layout, const K& key,
+                             C cmp = C{}) {
+    const T*   items = layout.ptr;
+    const t_n_ n     = get(layout.n);
+    // the descendants 4 levels down share cache lines for small items.
+    constexpr t_n_ AHEAD = 64/sizeof(T) ? 64/sizeof(T) : 1;
+    t_ix_ k = 1;
+    while (k <= n) {
+      __builtin_prefetch(items + AHEAD*k - 1);
+      k = 2*k + cmp(items[k - 1], key);
+    }
+    k >>= __builtin_ffsll(~(long long)k);
+    return t_ix{k ? k - 1 : n};
+  }
+
+  template<typename T, typename TAG, typename K, typename C = t_less>
+  inline
+  t_ix eytzinger_lower_bound(t_range<T, TAG> layout, const K& key,
+                             C cmp = C{}) {
+    return eytzinger_lower_bound(t_crange<T, TAG>{layout}, key, cmp);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  constexpr t_n_ SORT_INSERTION_  = 24;
+  constexpr t_n_ SORT_NINTHER_    = 128;
+  constexpr t_n_ SORT_PARTIAL_    = 8;
+
+  template<typename T, typename C>
+  inline
+  t_void insertion_sort_(T* begin, T* end, C& cmp) {
+    if (begin == end)
+      return;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+      if (cmp(*cur, *(cur - 1))) {
+        T  tmp  = std::move(*cur);
+        T* hole = cur;
+        do {
+          *hole = std::move(*(hole - 1));
+          --hole;
+        } while (hole != begin && cmp(tmp, *(hole - 1)));
+        *hole = std::move(tmp);
+      }
+    }
+  }
+
+  // an item before begin is known to be not greater than all of them.
+  template<typename T, typename C>
+  inline
+  t_void unguarded_insertion_sort_(T* begin, T* end, C& cmp) {
+    if (begin == end)
+      return;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+      if (cmp(*cur, *(cur - 1))) {
+        T  tmp  = std::move(*cur);
+        T* hole = cur;
+        do {
+          *hole = std::move(*(hole - 1));
+          --hole;
+        } while (cmp(tmp, *(hole - 1)));
+        *hole = std::move(tmp);
+      }
+    }
+  }
+
+  // insertion sort that gives up after SORT_PARTIAL_ moves.
+  template<typename T, typename C>
+  inline
+  t_bool partial_insertion_sort_(T* begin, T* end, C& cmp) {
+    if (begin == end)
+      return true;
+    t_n_ moves = 0;
+    for (T* cur = begin + 1; cur != end; ++cur) {
+      if (cmp(*cur, *(cur - 1))) {
+        T  tmp  = std::move(*cur);
+        T* hole = cur;
+        do {
+          *hole = std::move(*(hole - 1));
+          --hole;
+        } while (hole != begin && cmp(tmp, *(hole - 1)));
+        *hole = std::move(tmp);
+        moves += cur - hole;
+      }
+      if (moves > SORT_PARTIAL_)
+        return false;
+    }
+    return true;
+  }
+
+  template<typename T, typename C>
+  inline
+  t_void sort2_(T* a, T* b, C& cmp) {
+    if (cmp(*b, *a))
+      std::swap(*a, *b);
+  }
+
+  template<typename T, typename C>
+  inline
+  t_void sort3_(T* a, T* b, T* c, C& cmp) {
+    sort2_(a, b, cmp);
+    sort2_(b, c, cmp);
+    sort2_(a, b, cmp);
+  }
+
+  // the pivot is *begin. items equal to it go right. returns the final
+  // place of the pivot and whether no item had to move.
+  template<typename T, typename C>
+  inline
+  std::pair<T*, t_bool> partition_right_(T* begin, T* end, C& cmp) {
+    T  pivot = std::move(*begin);
+    T* first = begin;
+    T* last  = end;
+
+    // the median of 3 guarantees an item >= pivot to the right.
+    while (cmp(*++first, pivot))
+      ;
+    if (first - 1 == begin)
+      while (first < last && !cmp(*--last, pivot))
+        ;
+    else
+      while (!cmp(*--last, pivot))
+        ;
+
+    const t_bool partitioned = first >= last;
+    while (first < last) {
+      std::swap(*first, *last);
+      while (cmp(*++first, pivot))
+        ;
+      while (!cmp(*--last, pivot))
+        ;
+    }
+
+    T* pivot_pos = first - 1;
+    *begin     = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return {pivot_pos, partitioned};
+  }
+
+  // the pivot is *begin and equal to the item before begin. items equal
+  // to it go left, where they are done.
+  template<typename T, typename C>
+  inline
+  T* partition_left_(T* begin, T* end, C& cmp) {
+    T  pivot = std::move(*begin);
+    T* first = begin;
+    T* last  = end;
+
+    while (cmp(pivot, *--last))
+      ;
+    if (last + 1 == end)
+      while (first < last && !cmp(pivot, *++first))
+        ;
+    else
+      while (!cmp(pivot, *++first))
+        ;
+
+    while (first < last) {
+      std::swap(*first, *last);
+      while (cmp(pivot, *--last))
+        ;
+      while (!cmp(pivot, *++first))
+        ;
+    }
+
+    T* pivot_pos = last;
+    *begin     = std::move(*pivot_pos);
+    *pivot_pos = std::move(pivot);
+    return pivot_pos;
+  }
+
+  template<typename T, typename C>
+  inline
+  t_void heap_sort_(T* begin, T* end, C& cmp) {
+    std::make_heap(begin, end, cmp);
+    std::sort_heap(begin, end, cmp);
+  }
+
+  template<typename T, typename C>
+  t_void sort_(T* begin, T* end, C& cmp, t_n_ bad_allowed, t_bool leftmost) {
+    for (;;) {
+      const t_n_ size = end - begin;
+      if (size < SORT_INSERTION_) {
+        if (leftmost)
+          insertion_sort_(begin, end, cmp);
+        else
+          unguarded_insertion_sort_(begin, end, cmp);
+        return;
+      }
+
+      const t_n_ half = size/2;
+      if (size > SORT_NINTHER_) {
+        sort3_(begin, begin + half, end - 1, cmp);
+        sort3_(begin + 1, begin + (half - 1), end - 2, cmp);
+        sort3_(begin + 2, begin + (half + 1), end - 3, cmp);
+        sort3_(begin + (half - 1), begin + half, begin + (half + 1), cmp);
+        std::swap(*begin, *(begin + half));
+      } else
+        sort3_(begin + half, begin, end - 1, cmp);
+
+      // equal to the item before, that is the smallest of this range.
+      if (!leftmost && !cmp(*(begin - 1), *begin)) {
+        begin = partition_left_(begin, end, cmp) + 1;
+        continue;
+      }
+
+      auto       part   = partition_right_(begin, end, cmp);
+      T*         pivot  = part.first;
+      const t_n_ l_size = pivot - begin;
+      const t_n_ r_size = end - (pivot + 1);
+
+      if (l_size < size/8 || r_size < size/8) {
+        if (!--bad_allowed) {
+          heap_sort_(begin, end, cmp);
+          return;
+        }
+        // break patterns that made the pivot bad.
+        if (l_size >= SORT_INSERTION_) {
+          std::swap(*begin, *(begin + l_size/4));
+          std::swap(*(pivot - 1), *(pivot - l_size/4));
+          if (l_size > SORT_NINTHER_) {
+            std::swap(*(begin + 1), *(begin + (l_size/4 + 1)));
+            std::swap(*(begin + 2), *(begin + (l_size/4 + 2)));
+            std::swap(*(pivot - 2), *(pivot - (l_size/4 + 1)));
+            std::swap(*(pivot - 3), *(pivot - (l_size/4 + 2)));
+          }
+        }
+        if (r_size >= SORT_INSERTION_) {
+          std::swap(*(pivot + 1), *(pivot + (1 + r_size/4)));
+          std::swap(*(end - 1), *(end - r_size/4));
+          if (r_size > SORT_NINTHER_) {
+            std::swap(*(pivot + 2), *(pivot + (2 + r_size/4)));
+            std::swap(*(pivot + 3), *(pivot + (3 + r_size/4)));
+            std::swap(*(end - 2), *(end - (1 + r_size/4)));
+            std::swap(*(end - 3), *(end - (2 + r_size/4)));
+          }
+        }
+      } else if (part.second &&
+                 partial_insertion_sort_(begin, pivot, cmp) &&
+                 partial_insertion_sort_(pivot + 1, end, cmp))
+        return;
+
+      sort_(begin, pivot, cmp, bad_allowed, leftmost);
+      begin    = pivot + 1;
+      leftmost = false;
+    }
+  }
+
+  template<typename T, typename TAG, typename C = t_less>
+  inline
+  t_void sort(t_range<T, TAG> range, C cmp = C{}) {
+    const t_n_ n = get(range.n);
+    if (n < 2)
+      return;
+    t_n_ log2 = 0;
+    for (t_n_ i = n; i > 1; i >>= 1)
+      ++log2;
+    sort_(range.ptr, range.ptr + n, cmp, log2, true);
+  }
+
+  template<typename T, typename TAG, typename C = t_less>
+  inline
+  t_bool is_sorted(t_crange<T, TAG> range, C cmp = C{}) {
+    for (t_ix_ ix = 1, n = get(range.n); ix < n; ++ix)
+      if (cmp(range.ptr[ix], range.ptr[ix - 1]))
+        return false;
+    return true;
+  }
+
+  template<typename T, typename TAG, typename C = t_less>
+  inline
+  t_bool is_sorted(t_range<T, TAG> range, C cmp = C{}) {
+    return is_sorted(t_crange<T, TAG>{range}, cmp);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
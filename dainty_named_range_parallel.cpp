@@ -0,0 +1,262 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "dainty_named_range_parallel.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ SLOTS_ = 64;
+
+    // the chunks [begin, end) a thread still has to run, packed so that
+    // the owner (from the front) and thieves (from the back) can race on
+    // them with compare and swap.
+    struct alignas(64) t_slot_ {
+      std::atomic<t_uint64> chunks{0};
+    };
+
+    inline t_uint64 pack_(t_ix_ begin, t_ix_ end) {
+      return (t_uint64)begin << 32 | end;
+    }
+    inline t_ix_ begin_(t_uint64 chunks) { return chunks >> 32; }
+    inline t_ix_ end_  (t_uint64 chunks) { return chunks & 0xffffffff; }
+
+    // a job is on the list of the pool while its caller runs it. joined
+    // (a bit per worker) and active are guarded by the lock of the pool.
+    struct t_job_ {
+      t_chunk_fn_ fn;
+      p_void      ctx;
+      t_n_        slots;
+      t_slot_     slot[SLOTS_];
+      t_uint64    joined = 0;
+      t_n_        active = 0; // workers inside the job
+      t_job_*     prev   = nullptr;
+      t_job_*     next   = nullptr;
+    };
+
+    struct t_pool_ {
+      std::mutex               submit; // changes to workers
+      std::mutex               lock;
+      std::condition_variable  cond;   // a job was added, or stop
+      std::condition_variable  left;   // a job lost its last worker
+      std::vector<std::thread> workers;
+      t_n_                     want  = (t_n_)-1; // not started yet
+      t_job_*                  jobs  = nullptr;
+      t_bool                   stop  = false;
+    };
+
+    t_pool_                  pool_;
+    thread_local t_bool      inside_ = false;
+
+    t_bool take_(t_slot_& slot, t_ix_& ix) {
+      auto chunks = slot.chunks.load(std::memory_order_acquire);
+      while (begin_(chunks) < end_(chunks)) {
+        if (slot.chunks.compare_exchange_weak(chunks,
+              pack_(begin_(chunks) + 1, end_(chunks)),
+              std::memory_order_acq_rel)) {
+          ix = begin_(chunks);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // moves the back half of another slot into the own one.
+    t_bool steal_(t_job_& job, t_ix_ own) {
+      for (t_ix_ step = 1; step < job.slots; ++step) {
+        auto& victim = job.slot[(own + step) % job.slots];
+        auto  chunks = victim.chunks.load(std::memory_order_acquire);
+        while (begin_(chunks) < end_(chunks)) {
+          auto begin = begin_(chunks), end = end_(chunks);
+          auto mid   = begin + (end - begin)/2;
+          if (victim.chunks.compare_exchange_weak(chunks, pack_(begin, mid),
+                                                  std::memory_order_acq_rel)) {
+            job.slot[own].chunks.store(pack_(mid, end),
+                                       std::memory_order_release);
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    t_void work_(t_job_& job, t_ix_ own) {
+      inside_ = true;
+      for (;;) {
+        t_ix_ ix;
+        while (take_(job.slot[own], ix))
+          job.fn(job.ctx, ix);
+        if (!steal_(job, own))
+          break;
+      }
+      inside_ = false;
+    }
+
+    t_void run_worker_(t_ix_ own) {
+      const t_uint64 bit = (t_uint64)1 << own;
+      for (;;) {
+        t_job_* job = nullptr;
+        {
+          std::unique_lock<std::mutex> guard{pool_.lock};
+          for (;;) {
+            if (pool_.stop)
+              return;
+            for (job = pool_.jobs; job; job = job->next)
+              if (own < job->slots && !(job->joined & bit))
+                break;
+            if (job)
+              break;
+            pool_.cond.wait(guard);
+          }
+          job->joined |= bit;
+          ++job->active;
+        }
+        work_(*job, own);
+        std::lock_guard<std::mutex> guard{pool_.lock};
+        if (!--job->active)
+          pool_.left.notify_all();
+      }
+    }
+
+    t_void stop_workers_() {
+      {
+        std::lock_guard<std::mutex> guard{pool_.lock};
+        pool_.stop = true;
+      }
+      pool_.cond.notify_all();
+      for (auto& worker : pool_.workers)
+        worker.join();
+      pool_.workers.clear();
+      pool_.stop = false;
+    }
+
+    t_void start_workers_(t_n_ n) {
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        pool_.workers.emplace_back(run_worker_, ix + 1);
+    }
+
+    // with submit held.
+    t_void ensure_workers_() {
+      if (pool_.want == (t_n_)-1) {
+        auto cores = std::thread::hardware_concurrency();
+        pool_.want = cores > 1 ? cores - 1 : 0;
+        if (pool_.want > SLOTS_ - 1)
+          pool_.want = SLOTS_ - 1;
+      }
+      if (pool_.workers.size() != pool_.want) {
+        stop_workers_();
+        start_workers_(pool_.want);
+      }
+    }
+
+    struct t_pool_owner_ {
+      ~t_pool_owner_() {
+        std::lock_guard<std::mutex> guard{pool_.submit};
+        stop_workers_();
+      }
+    } pool_owner_;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_void set_parallel_workers(t_n n) {
+    std::lock_guard<std::mutex> guard{pool_.submit};
+    pool_.want = get(n) < SLOTS_ ? get(n) : SLOTS_ - 1;
+    ensure_workers_();
+  }
+
+  t_n get_parallel_workers() {
+    std::lock_guard<std::mutex> guard{pool_.submit};
+    ensure_workers_();
+    return t_n{pool_.workers.size()};
+  }
+
+  t_void run_parallel_(t_n_ chunks, t_chunk_fn_ fn, p_void ctx) {
+    if (inside_ || chunks == 1) {
+      for (t_ix_ ix = 0; ix < chunks; ++ix)
+        fn(ctx, ix);
+      return;
+    }
+
+    assert_if_true(chunks > 0xffffffff, P_cstr{"range: too many chunks"});
+
+    t_job_ job;
+    job.fn  = fn;
+    job.ctx = ctx;
+    {
+      std::lock_guard<std::mutex> guard{pool_.submit};
+      ensure_workers_();
+      job.slots = pool_.workers.size() + 1;
+    }
+    if (job.slots > chunks)
+      job.slots = chunks;
+    for (t_ix_ ix = 0; ix < job.slots; ++ix)
+      job.slot[ix].chunks.store(pack_(ix*chunks/job.slots,
+                                      (ix + 1)*chunks/job.slots),
+                                std::memory_order_relaxed);
+    if (job.slots > 1) {
+      {
+        std::lock_guard<std::mutex> lock{pool_.lock};
+        job.next = pool_.jobs;
+        if (pool_.jobs)
+          pool_.jobs->prev = &job;
+        pool_.jobs = &job;
+      }
+      pool_.cond.notify_all();
+    }
+
+    work_(job, 0);
+
+    if (job.slots > 1) {
+      // every chunk is taken, those still running belong to an active
+      // worker. off the list no worker can join any more.
+      std::unique_lock<std::mutex> lock{pool_.lock};
+      if (job.prev)
+        job.prev->next = job.next;
+      else
+        pool_.jobs = job.next;
+      if (job.next)
+        job.next->prev = job.prev;
+      pool_.left.wait(lock, [&] { return !job.active; });
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,252 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_RANGE_PARALLEL_H_
+#define _DAINTY_NAMED_RANGE_PARALLEL_H_
+
+// parallel: each, transform and reduce over a t_range on all cores.
+//
+//   the range is cut into chunks of about grain items, the chunk edges
+//   falling on 64 byte boundaries when the item size allows it, so that no
+//   two threads write the same cache line. ranges below threshold items
+//   run sequentially on the calling thread.
+//
+//   the chunks run on a shared pool of worker threads, with the caller
+//   taking part. every thread starts with its share of the chunks and
+//   steals half of the remaining chunks of another thread when it runs
+//   out. calls from several threads run at the same time, each worker
+//   joins every call in flight once. the caller sleeps until the last
+//   worker has left its call. a call from within a chunk runs
+//   sequentially.
+//
+//   the sizes are checked once per call, the chunks then walk raw
+//   pointers without per item checks.
+//
+//   parallel_reduce folds every chunk from identity with fold and
+//   combines the chunk results in order with combine. both must be
+//   associative and identity must be neutral for the result to be the
+//   same as a sequential fold.
+
+#include <vector>
+#include "dainty_named_assert.h"
+#include "dainty_named_range.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_parallel_params {
+    t_n grain     = t_n{8192};  // items per chunk
+    t_n threshold = t_n{65536}; // fewer items run sequentially
+
+    t_parallel_params() = default;
+    t_parallel_params(t_n _grain, t_n _threshold)
+      : grain(_grain), threshold(_threshold) {
+    }
+  };
+  using R_parallel_params = t_prefix<t_parallel_params>::R_;
+
+  // the pool has hardware_concurrency() - 1 workers unless set otherwise.
+  // changing it waits for the workers to finish the chunks they hold.
+  t_void set_parallel_workers(t_n);
+  t_n    get_parallel_workers();
+
+///////////////////////////////////////////////////////////////////////////////
+
+  using t_chunk_fn_ = t_void (*)(p_void, t_ix_);
+
+  // runs fn(ctx, ix) for every ix in [0, chunks), returns when all ran.
+  t_void run_parallel_(t_n_ chunks, t_chunk_fn_ fn, p_void ctx);
+
+  // items [begin, end) of chunk ix, see mk_chunks_.
+  struct t_chunks_ {
+    t_n_ n;
+    t_n_ head;  // items in front of the first 64 byte boundary
+    t_n_ grain;
+    t_n_ chunks;
+
+    inline
+    t_void get(t_ix_ ix, t_ix_& begin, t_ix_& end) const {
+      begin = ix ? head + ix*grain : 0;
+      end   = head + (ix + 1)*grain;
+      if (end > n)
+        end = n;
+    }
+  };
+
+  template<typename T>
+  inline
+  t_chunks_ mk_chunks_(const T* ptr, t_n_ n, t_n_ grain) {
+    t_n_ head = 0;
+    if (64 % sizeof(T) == 0) {
+      const t_n_ per_line = 64/sizeof(T);
+      grain = (grain + per_line - 1)/per_line*per_line;
+      head  = (64 - (std::uintptr_t)ptr % 64) % 64/sizeof(T);
+    }
+    if (!grain)
+      grain = 1;
+    if (head > n)
+      head = n;
+    t_n_ chunks = (n - head + grain - 1)/grain;
+    if (!chunks)
+      chunks = 1;
+    return t_chunks_{n, head, grain, chunks};
+  }
+
+  template<typename F>
+  inline
+  t_void run_chunks_(t_n_ chunks, F& f) {
+    run_parallel_(chunks, [](p_void ctx, t_ix_ ix) { (*(F*)ctx)(ix); },
+                  &f);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG, typename F>
+  inline
+  t_void parallel_each(t_range<T, TAG> range, F f,
+                       R_parallel_params params = t_parallel_params{}) {
+    auto ptr = range.ptr;
+    auto n   = get(range.n);
+    if (n < get(params.threshold)) {
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        f(ptr[ix]);
+      return;
+    }
+    auto chunks = mk_chunks_(ptr, n, get(params.grain));
+    auto chunk  = [&](t_ix_ ix) {
+      t_ix_ begin, end;
+      chunks.get(ix, begin, end);
+      for (; begin < end; ++begin)
+        f(ptr[begin]);
+    };
+    run_chunks_(chunks.chunks, chunk);
+  }
+
+  template<typename T, typename TAG, typename F>
+  inline
+  t_void parallel_each(t_crange<T, TAG> range, F f,
+                       R_parallel_params params = t_parallel_params{}) {
+    auto ptr = range.ptr;
+    auto n   = get(range.n);
+    if (n < get(params.threshold)) {
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        f(ptr[ix]);
+      return;
+    }
+    auto chunks = mk_chunks_(ptr, n, get(params.grain));
+    auto chunk  = [&](t_ix_ ix) {
+      t_ix_ begin, end;
+      chunks.get(ix, begin, end);
+      for (; begin < end; ++begin)
+        f(ptr[begin]);
+    };
+    run_chunks_(chunks.chunks, chunk);
+  }
+
+  // out[ix] = f(in[ix]), the ranges must be of the same size. the chunks
+  // are cut on out, which is the range being written.
+  template<typename T, typename TAG, typename T1, typename TAG1, typename F>
+  inline
+  t_void parallel_transform(t_crange<T, TAG> in, t_range<T1, TAG1> out, F f,
+                            R_parallel_params params = t_parallel_params{}) {
+    auto src = in.ptr;
+    auto dst = out.ptr;
+    auto n   = get(in.n);
+    if (n != get(out.n))
+      assert_now(P_cstr{"range: not same size"});
+    if (n < get(params.threshold)) {
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        dst[ix] = f(src[ix]);
+      return;
+    }
+    auto chunks = mk_chunks_(dst, n, get(params.grain));
+    auto chunk  = [&](t_ix_ ix) {
+      t_ix_ begin, end;
+      chunks.get(ix, begin, end);
+      for (; begin < end; ++begin)
+        dst[begin] = f(src[begin]);
+    };
+    run_chunks_(chunks.chunks, chunk);
+  }
+
+  template<typename T, typename TAG, typename T1, typename TAG1, typename F>
+  inline
+  t_void parallel_transform(t_range<T, TAG> in, t_range<T1, TAG1> out, F f,
+                            R_parallel_params params = t_parallel_params{}) {
+    parallel_transform(t_crange<T, TAG>{in}, out, f, params);
+  }
+
+  template<typename T, typename TAG, typename R, typename F, typename G>
+  inline
+  R parallel_reduce(t_crange<T, TAG> range, R identity, F fold, G combine,
+                    R_parallel_params params = t_parallel_params{}) {
+    auto ptr = range.ptr;
+    auto n   = get(range.n);
+    if (n < get(params.threshold)) {
+      R value = identity;
+      for (t_ix_ ix = 0; ix < n; ++ix)
+        value = fold(value, ptr[ix]);
+      return value;
+    }
+    auto chunks = mk_chunks_(ptr, n, get(params.grain));
+
+    struct alignas(64) t_part_ { R value; };
+    std::vector<t_part_> parts(chunks.chunks, t_part_{identity});
+    auto chunk = [&](t_ix_ ix) {
+      t_ix_ begin, end;
+      chunks.get(ix, begin, end);
+      R value = identity;
+      for (; begin < end; ++begin)
+        value = fold(value, ptr[begin]);
+      parts[ix].value = value;
+    };
+    run_chunks_(chunks.chunks, chunk);
+
+    R value = identity;
+    for (t_ix_ ix = 0; ix < chunks.chunks; ++ix)
+      value = combine(value, parts[ix].value);
+    return value;
+  }
+
+  template<typename T, typename TAG, typename R, typename F, typename G>
+  inline
+  R parallel_reduce(t_range<T, TAG> range, R identity, F fold, G combine,
+                    R_parallel_params params = t_parallel_params{}) {
+    return parallel_reduce(t_crange<T, TAG>{range}, identity, fold, combine,
+                           params);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -0,0 +1,370 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstring>
+#include "dainty_named_range_simd.h"
+
+// every entry point is compiled twice, for avx2 and for the baseline, and
+// bound to the one that fits the cpu by an ifunc resolver at load time.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define DAINTY_NAMED_RANGE_SIMD_CLONES_ \
+  __attribute__((target_clones("avx2", "default")))
+#else
+#define DAINTY_NAMED_RANGE_SIMD_CLONES_
+#endif
+
+// the kernels pass 32 byte vectors around, which has no stable abi without
+// avx. they are always inlined, so no such vector crosses a call.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// the kernels must be inlined into each clone to be built for its target.
+#define DAINTY_NAMED_RANGE_SIMD_INLINE_ inline __attribute__((always_inline))
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ VEC_BYTES_ = 32;
+
+    template<t_n_> struct t_lane_;
+    template<> struct t_lane_<1> { using t_int_ = t_int8;  };
+    template<> struct t_lane_<2> { using t_int_ = t_int16; };
+    template<> struct t_lane_<4> { using t_int_ = t_int32; };
+    template<> struct t_lane_<8> { using t_int_ = t_int64; };
+
+    template<typename B>
+    struct t_simd_ {
+      static constexpr t_n_ LANES = VEC_BYTES_/sizeof(B);
+      using t_int_ = typename t_lane_<sizeof(B)>::t_int_;
+      typedef B      t_vec  __attribute__((vector_size(VEC_BYTES_)));
+      typedef t_int_ t_mask __attribute__((vector_size(VEC_BYTES_)));
+    };
+
+    typedef t_uint64 t_any_ __attribute__((vector_size(VEC_BYTES_)));
+
+    template<typename V, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    V load_(const B* ptr) {
+      V vec;
+      std::memcpy(&vec, ptr, sizeof(vec));
+      return vec;
+    }
+
+    template<typename V, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_void store_(B* ptr, const V& vec) {
+      std::memcpy(ptr, &vec, sizeof(vec));
+    }
+
+    template<typename M>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_bool is_any_(const M& mask) {
+      auto any = (t_any_)mask;
+      return any[0] | any[1] | any[2] | any[3];
+    }
+
+    template<t_bool MAX, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_bool is_better_(B value, B best) {
+      return MAX ? value > best : value < best;
+    }
+
+    template<t_bool MAX, typename V>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    V pick_(const V& value, const V& best) {
+      if (MAX)
+        return value > best ? value : best;
+      return value < best ? value : best;
+    }
+
+    // lanes moved up by K, zeros shifted in.
+    template<t_n_ K, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    typename t_simd_<B>::t_vec shift_(const typename t_simd_<B>::t_vec& vec) {
+      using t_mask = typename t_simd_<B>::t_mask;
+      constexpr t_n_ LANES = t_simd_<B>::LANES;
+      t_mask ix;
+      for (t_ix_ lane = 0; lane < LANES; ++lane)
+        ix[lane] = lane >= K ? lane - K : LANES;
+      return __builtin_shuffle(vec, typename t_simd_<B>::t_vec{}, ix);
+    }
+
+    template<t_n_ K, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    typename t_simd_<B>::t_vec
+        scan_vec_(const typename t_simd_<B>::t_vec& vec) {
+      if constexpr (K < t_simd_<B>::LANES)
+        return scan_vec_<2*K, B>(vec + shift_<K, B>(vec));
+      else
+        return vec;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+
+    // integers are added unsigned, so that they wrap instead of overflow.
+    template<typename B, t_bool = std::is_integral<B>::value>
+    struct t_wrap_ { using t_type_ = B; };
+
+    template<typename B>
+    struct t_wrap_<B, true> { using t_type_ = std::make_unsigned_t<B>; };
+
+    template<typename B>
+    using t_wrap_type_ = typename t_wrap_<B>::t_type_;
+
+////////////////////////////////////////////////////////////////////////////////
+
+    // the lanes sum_ adds B items in: 32 bit for 8 and 16 bit items,
+    // otherwise the lanes of the result.
+    template<typename S, typename B>
+    using t_sum_lane_ =
+      typename std::conditional<(sizeof(B) < 4),
+        typename std::conditional<std::is_signed<B>::value,
+          t_int32, t_uint32>::type, S>::type;
+
+    // adds one vector of B items at ptr into the lanes of acc.
+    template<typename B, typename A>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_void add_vec_(A& acc, const B* ptr) {
+      using M = typename std::remove_reference<decltype(acc[0])>::type;
+      if constexpr (sizeof(B) < 4) {
+        // 8 and 16 bit items: every 32 bit lane holds 4 or 2 of them,
+        // shifted to the top and back down with sign or zero extension.
+        typedef t_uint32 t_bits __attribute__((vector_size(VEC_BYTES_)));
+        constexpr t_n_ BITS = 8*sizeof(B);
+        auto bits = load_<t_bits>(ptr);
+        for (t_n_ shift = 32 - BITS; shift < 32; shift -= BITS)
+          acc += (A)(bits << shift) >> (32 - BITS);
+      } else if constexpr (sizeof(B) == sizeof(M)) {
+        acc += (A)load_<typename t_simd_<B>::t_vec>(ptr);
+      } else {
+        // 32 bit items into 64 bit lanes, as low and high halves. signed
+        // items have their sign bit flipped, which adds 2^31 to each, see
+        // sum_.
+        typedef t_uint64 t_bits __attribute__((vector_size(VEC_BYTES_)));
+        auto bits = load_<t_bits>(ptr);
+        if constexpr (std::is_signed<B>::value)
+          bits ^= 0x8000000080000000ul;
+        acc += (A)((bits & 0xfffffffful) + (bits >> 32));
+      }
+    }
+
+    // four independent accumulators keep the adds from waiting on each
+    // other. 32 bit lanes are emptied into the sum before they overflow.
+    template<typename S0, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    S0 sum_(const B* ptr, t_n_ n) {
+      using S = t_wrap_type_<S0>;
+      using M = t_sum_lane_<S, B>;
+      typedef M t_acc __attribute__((vector_size(VEC_BYTES_)));
+      constexpr t_n_ LANES = t_simd_<B>::LANES;
+      constexpr t_n_ STEP  = 4*LANES;
+      constexpr t_n_ BLOCK = sizeof(M) < sizeof(S) ? 4096*STEP : ~0ul/2;
+
+      S sum = 0;
+      t_ix_ ix = 0;
+      while (ix + STEP <= n) {
+        t_acc acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        auto end = n - (n - ix) % STEP;
+        if (end - ix > BLOCK)
+          end = ix + BLOCK;
+        for (; ix < end; ix += STEP) {
+          add_vec_(acc0, ptr + ix);
+          add_vec_(acc1, ptr + ix + LANES);
+          add_vec_(acc2, ptr + ix + 2*LANES);
+          add_vec_(acc3, ptr + ix + 3*LANES);
+        }
+        acc0 += acc1;
+        acc2 += acc3;
+        acc0 += acc2;
+        for (t_ix_ lane = 0; lane < VEC_BYTES_/sizeof(M); ++lane)
+          sum += (S)acc0[lane];
+      }
+      if constexpr (sizeof(B) == 4 && std::is_signed<B>::value)
+        sum -= (S)ix << 31;
+      for (; ix < n; ++ix)
+        sum += (S)ptr[ix];
+      return (S0)sum;
+    }
+
+    template<t_bool MAX, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    B extreme_(const B* ptr, t_n_ n) {
+      using t_vec = typename t_simd_<B>::t_vec;
+      constexpr t_n_ LANES = t_simd_<B>::LANES;
+
+      B best = ptr[0];
+      t_ix_ ix = 0;
+      if (n >= 2*LANES) {
+        t_vec acc[2] = {load_<t_vec>(ptr), load_<t_vec>(ptr + LANES)};
+        for (ix = 2*LANES; ix + 2*LANES <= n; ix += 2*LANES)
+          for (t_ix_ k = 0; k < 2; ++k)
+            acc[k] = pick_<MAX>(load_<t_vec>(ptr + ix + k*LANES), acc[k]);
+        acc[0] = pick_<MAX>(acc[1], acc[0]);
+        best = acc[0][0];
+        for (t_ix_ lane = 1; lane < LANES; ++lane)
+          if (is_better_<MAX>(acc[0][lane], best))
+            best = acc[0][lane];
+      }
+      for (; ix < n; ++ix)
+        if (is_better_<MAX>(ptr[ix], best))
+          best = ptr[ix];
+      return best;
+    }
+
+    // the extreme of every block is found with vectors, the block holding
+    // the first best one is then searched for its index.
+    template<t_bool MAX, typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_ix_ extreme_ix_(const B* ptr, t_n_ n) {
+      constexpr t_n_ BLOCK = 64*t_simd_<B>::LANES;
+
+      B     best  = ptr[0];
+      t_ix_ block = 0;
+      for (t_ix_ ix = 0; ix < n; ix += BLOCK) {
+        auto value = extreme_<MAX>(ptr + ix, n - ix < BLOCK ? n - ix : BLOCK);
+        if (is_better_<MAX>(value, best)) {
+          best  = value;
+          block = ix;
+        }
+      }
+      for (; block < n - 1 && ptr[block] != best; ++block)
+        ;
+      return block;
+    }
+
+    template<typename B>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_ix_ find_(const B* ptr, t_n_ n, B value) {
+      using t_vec = typename t_simd_<B>::t_vec;
+      constexpr t_n_ LANES = t_simd_<B>::LANES;
+
+      const t_vec key = t_vec{} + value;
+      t_ix_ ix = 0;
+      for (; ix + 4*LANES <= n; ix += 4*LANES) {
+        auto hit = (load_<t_vec>(ptr + ix)           == key) |
+                   (load_<t_vec>(ptr + ix + LANES)   == key) |
+                   (load_<t_vec>(ptr + ix + 2*LANES) == key) |
+                   (load_<t_vec>(ptr + ix + 3*LANES) == key);
+        if (is_any_(hit))
+          break;
+      }
+      for (; ix < n && ptr[ix] != value; ++ix)
+        ;
+      return ix;
+    }
+
+    // each vector is scanned in log2(lanes) shift and add steps, then the
+    // running total of the vectors before it is added.
+    template<typename B0>
+    DAINTY_NAMED_RANGE_SIMD_INLINE_
+    t_void inclusive_scan_(B0* out0, const B0* in0, t_n_ n) {
+      using B = t_wrap_type_<B0>;
+      auto out = (B*)out0;
+      auto in  = (const B*)in0;
+      using t_vec  = typename t_simd_<B>::t_vec;
+      using t_mask = typename t_simd_<B>::t_mask;
+      constexpr t_n_ LANES = t_simd_<B>::LANES;
+
+      t_ix_ ix    = 0;
+      B     total = 0;
+      if constexpr (std::is_integral<B>::value) {
+        using t_int_ = typename t_simd_<B>::t_int_;
+        const t_mask last = t_mask{} + (t_int_)(LANES - 1);
+        t_vec carry = {};
+        for (; ix + LANES <= n; ix += LANES) {
+          auto vec = scan_vec_<1, B>(load_<t_vec>(in + ix)) + carry;
+          store_(out + ix, vec);
+          carry = __builtin_shuffle(vec, last);
+        }
+        total = carry[0];
+      }
+      for (; ix < n; ++ix)
+        out[ix] = total += in[ix];
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define DAINTY_NAMED_RANGE_SIMD_DEF_(T, S)                                   \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  S get_sum_(const T* ptr, t_n_ n) {                                          \
+    return sum_<S>(ptr, n);                                                   \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  T get_min_(const T* ptr, t_n_ n) {                                          \
+    return extreme_<false>(ptr, n);                                           \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  T get_max_(const T* ptr, t_n_ n) {                                          \
+    return extreme_<true>(ptr, n);                                            \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  t_ix_ get_min_ix_(const T* ptr, t_n_ n) {                                   \
+    return extreme_ix_<false>(ptr, n);                                        \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  t_ix_ get_max_ix_(const T* ptr, t_n_ n) {                                   \
+    return extreme_ix_<true>(ptr, n);                                         \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  t_ix_ find_ix_(const T* ptr, t_n_ n, T value) {                             \
+    return find_(ptr, n, value);                                              \
+  }                                                                           \
+                                                                              \
+  DAINTY_NAMED_RANGE_SIMD_CLONES_                                             \
+  t_void prefix_sum_(T* out, const T* in, t_n_ n) {                           \
+    inclusive_scan_(out, in, n);                                              \
+  }
+
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_int8,   t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_int16,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_int32,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_int64,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_llong,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_uint8,  t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_uint16, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_uint32, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_uint64, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_ullong, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DEF_(t_double, t_double)
+
+#undef DAINTY_NAMED_RANGE_SIMD_DEF_
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
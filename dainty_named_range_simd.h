@@ -0,0 +1,244 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_RANGE_SIMD_H_
+#define _DAINTY_NAMED_RANGE_SIMD_H_
+
+// simd: vectorized reductions and scans over ranges of numbers.
+//
+//   get_sum, get_min, get_max, get_min_ix, get_max_ix, find_ix and
+//   prefix_sum work on ranges of t_int8 .. t_int64, t_uint8 .. t_uint64,
+//   t_llong, t_ullong and t_double, and of t_explicit wrappers of these,
+//   which are read in place as the type they wrap.
+//
+//   the kernels are built once per type and cloned for avx2 and the
+//   baseline instruction set, the clone is chosen at load time for the cpu
+//   the program runs on.
+//
+//   get_sum widens: integers add up as t_int64 or t_uint64 (wrapping on
+//   overflow), doubles as t_double, in a fixed number of partial sums, so
+//   the result is repeatable but can differ from a sequential sum in the
+//   last bits. prefix_sum writes the inclusive scan in the item type (in
+//   and out may be the same range), doubles are scanned in order.
+//
+//   get_min_ix, get_max_ix and find_ix return the first index that
+//   matches, find_ix returns n when nothing does. the result of a range
+//   holding a NaN is unspecified. min and max need a range that is not
+//   empty.
+
+#include <type_traits>
+#include "dainty_named_assert.h"
+#include "dainty_named_range.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace range
+{
+///////////////////////////////////////////////////////////////////////////////
+
+#define DAINTY_NAMED_RANGE_SIMD_DECL_(T, S)                                  \
+  S     get_sum_   (const T*, t_n_);                                          \
+  T     get_min_   (const T*, t_n_);                                          \
+  T     get_max_   (const T*, t_n_);                                          \
+  t_ix_ get_min_ix_(const T*, t_n_);                                          \
+  t_ix_ get_max_ix_(const T*, t_n_);                                          \
+  t_ix_ find_ix_   (const T*, t_n_, T);                                       \
+  t_void prefix_sum_(T*, const T*, t_n_);
+
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_int8,   t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_int16,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_int32,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_int64,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_llong,  t_int64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_uint8,  t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_uint16, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_uint32, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_uint64, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_ullong, t_uint64)
+  DAINTY_NAMED_RANGE_SIMD_DECL_(t_double, t_double)
+
+#undef DAINTY_NAMED_RANGE_SIMD_DECL_
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T>
+  struct t_simd_item_ {
+    using t_base_ = T;
+    static constexpr T mk_(T value) { return value; }
+  };
+
+  template<typename T, typename TAG, typename V>
+  struct t_simd_item_<t_explicit<T, TAG, V>> {
+    using t_base_ = T;
+    static t_explicit<T, TAG, V> mk_(T value) {
+      return t_explicit<T, TAG, V>{value};
+    }
+  };
+
+  template<typename T>
+  using t_simd_base_ = typename t_simd_item_<T>::t_base_;
+
+  template<typename T>
+  using t_simd_sum_ =
+    typename std::conditional<std::is_floating_point<t_simd_base_<T>>::value,
+      t_double,
+      typename std::conditional<std::is_signed<t_simd_base_<T>>::value,
+        t_int64, t_uint64>::type>::type;
+
+  template<typename T>
+  inline
+  const t_simd_base_<T>* simd_ptr_(const T* ptr) {
+    static_assert(std::is_arithmetic<t_simd_base_<T>>::value &&
+                  sizeof(T) == sizeof(t_simd_base_<T>),
+                  "range: simd needs numbers or t_explicit numbers");
+    return reinterpret_cast<const t_simd_base_<T>*>(ptr);
+  }
+
+  template<typename T>
+  inline
+  t_simd_base_<T>* simd_ptr_(T* ptr) {
+    return const_cast<t_simd_base_<T>*>(simd_ptr_((const T*)ptr));
+  }
+
+  template<typename T>
+  inline
+  t_simd_base_<T> simd_get_(const T& value) {
+    return *simd_ptr_(&value);
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_n_ simd_n_(t_crange<T, TAG> range) {
+    auto n = get(range.n);
+    assert_if_true(!n, P_cstr("range: simd min/max of empty range"));
+    return n;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG>
+  inline
+  t_simd_sum_<T> get_sum(t_crange<T, TAG> range) {
+    return get_sum_(simd_ptr_(range.ptr), get(range.n));
+  }
+
+  template<typename T, typename TAG>
+  inline
+  T get_min(t_crange<T, TAG> range) {
+    auto n = simd_n_(range);
+    return t_simd_item_<T>::mk_(get_min_(simd_ptr_(range.ptr), n));
+  }
+
+  template<typename T, typename TAG>
+  inline
+  T get_max(t_crange<T, TAG> range) {
+    auto n = simd_n_(range);
+    return t_simd_item_<T>::mk_(get_max_(simd_ptr_(range.ptr), n));
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix get_min_ix(t_crange<T, TAG> range) {
+    auto n = simd_n_(range);
+    return t_ix{get_min_ix_(simd_ptr_(range.ptr), n)};
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix get_max_ix(t_crange<T, TAG> range) {
+    auto n = simd_n_(range);
+    return t_ix{get_max_ix_(simd_ptr_(range.ptr), n)};
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix find_ix(t_crange<T, TAG> range, const T& value) {
+    return t_ix{find_ix_(simd_ptr_(range.ptr), get(range.n),
+                         simd_get_(value))};
+  }
+
+  // out[ix] = in[0] + .. + in[ix], the ranges must be of the same size.
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void prefix_sum(t_crange<T, TAG> in, t_range<T, TAG1> out) {
+    auto n = get(in.n);
+    if (n != get(out.n))
+      assert_now(P_cstr{"range: not same size"});
+    prefix_sum_(simd_ptr_(out.ptr), simd_ptr_(in.ptr), n);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<typename T, typename TAG>
+  inline
+  t_simd_sum_<T> get_sum(t_range<T, TAG> range) {
+    return get_sum(t_crange<T, TAG>{range});
+  }
+
+  template<typename T, typename TAG>
+  inline
+  T get_min(t_range<T, TAG> range) {
+    return get_min(t_crange<T, TAG>{range});
+  }
+
+  template<typename T, typename TAG>
+  inline
+  T get_max(t_range<T, TAG> range) {
+    return get_max(t_crange<T, TAG>{range});
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix get_min_ix(t_range<T, TAG> range) {
+    return get_min_ix(t_crange<T, TAG>{range});
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix get_max_ix(t_range<T, TAG> range) {
+    return get_max_ix(t_crange<T, TAG>{range});
+  }
+
+  template<typename T, typename TAG>
+  inline
+  t_ix find_ix(t_range<T, TAG> range, const T& value) {
+    return find_ix(t_crange<T, TAG>{range}, value);
+  }
+
+  template<typename T, typename TAG, typename TAG1>
+  inline
+  t_void prefix_sum(t_range<T, TAG> in, t_range<T, TAG1> out) {
+    prefix_sum(t_crange<T, TAG>{in}, out);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -91,6 +91,11 @@ namespace string
     r_string va_assign(P_cstr_ fmt, va_list vars);
     r_string va_append(P_cstr_ fmt, va_list vars);
 
+    // f(dst, n) writes up to n chars to dst and returns how many. n is
+    // need, or less when the overflow policy truncates.
+    template<class F>
+    r_string append(t_n need, F);
+
     t_void clear();
 
     t_void display() const;
@@ -155,6 +160,7 @@ namespace string
     t_string(const t_char (&)[N1]);
     template<t_n_ N1, class I1>
     t_string(const t_string<TAG, N1, I1>&);
+   ~t_string();
 
     r_string operator=(P_cstr);
     r_string operator=(R_block);
@@ -183,6 +189,11 @@ namespace string
     r_string va_assign(P_cstr_ fmt, va_list vars);
     r_string va_append(P_cstr_ fmt, va_list vars);
 
+    // f(dst, n) writes up to n chars to dst and returns how many. n is
+    // need, or less when the overflow policy truncates.
+    template<class F>
+    r_string append(t_n need, F);
+
     t_void clear();
 
     t_void display() const;
@@ -227,7 +238,7 @@ namespace string
 
   template<class TAG, t_n_ N, class I>
   inline
-  t_string<TAG, N, I>::t_string() : impl_{store_} {
+  t_string<TAG, N, I>::t_string() : impl_{&store_[0]} {
   }
 
   template<class TAG, t_n_ N, class I>
@@ -414,6 +425,15 @@ namespace string
     return *this;
   }
 
+  template<class TAG, t_n_ N, class I>
+  template<class F>
+  inline
+  typename t_string<TAG, N, I>::r_string
+      t_string<TAG, N, I>::append(t_n need, F f) {
+    impl_.append_(store_, N+1, get(need), f);
+    return *this;
+  }
+
   template<class TAG, t_n_ N, class I>
   inline
   t_void t_string<TAG, N, I>::display() const {
@@ -544,28 +564,32 @@ namespace string
   template<class TAG, class I>
   inline
   t_string<TAG, 0, I>::t_string(t_n max, t_n blks)
-    : blks_{get(blks)}, max_{calc_n_(get(max), blks_)}, store_{alloc_(max_)},
+    : blks_{get(blks)}, max_{calc_n_(get(max), blks_)},
+      store_{alloc_<TAG>(max_)},
       impl_{store_.get()} {
   }
 
   template<class TAG, class I>
   inline
   t_string<TAG, 0, I>::t_string(P_cstr str)
-    : blks_{0}, max_{calc_n_(length_(get(str)), blks_)}, store_{alloc_(max_)},
+    : blks_{0}, max_{calc_n_(length_(get(str)), blks_)},
+      store_{alloc_<TAG>(max_)},
       impl_{store_.get(), max_, get(str)} {
   }
 
   template<class TAG, class I>
   inline
   t_string<TAG, 0, I>::t_string(R_block block)
-    : blks_{0}, max_{calc_n_(get(block.max), blks_)}, store_{alloc_(max_)},
+    : blks_{0}, max_{calc_n_(get(block.max), blks_)},
+      store_{alloc_<TAG>(max_)},
       impl_{store_.get(), max_, block} {
   }
 
   template<class TAG, class I>
   inline
   t_string<TAG, 0, I>::t_string(R_crange range)
-    : blks_{0}, max_{calc_n_(get(range.n), blks_)}, store_{alloc_(max_)},
+    : blks_{0}, max_{calc_n_(get(range.n), blks_)},
+      store_{alloc_<TAG>(max_)},
       impl_{store_.get(), max_, begin(range), get(range.n)} {
   }
 
@@ -582,14 +606,15 @@ namespace string
   inline
   t_string<TAG, 0, I>::t_string(R_string str)
     : blks_{0}, max_{calc_n_(get(str.get_length()), blks_)},
-      store_{alloc_(max_)}, impl_{store_.get(), max_, get(str.get_cstr())} {
+      store_{alloc_<TAG>(max_)},
+      impl_{store_.get(), max_, get(str.get_cstr())} {
   }
 
   template<class TAG, class I>
   template<t_n_ N1>
   inline
   t_string<TAG, 0, I>::t_string(const t_char (&str)[N1])
-    : blks_{0}, max_{calc_n_(N1-1, blks_)}, store_{alloc_(max_)},
+    : blks_{0}, max_{calc_n_(N1-1, blks_)}, store_{alloc_<TAG>(max_)},
       impl_{store_.get(), max_, str} {
   }
 
@@ -598,7 +623,8 @@ namespace string
   inline
   t_string<TAG, 0, I>::t_string(const t_string<TAG, N1, I1>& str)
     : blks_{0}, max_{calc_n_(get(str.get_length()), blks_)},
-      store_{alloc_(max_)}, impl_{store_.get(), max_, get(str.get_cstr())} {
+      store_{alloc_<TAG>(max_)},
+      impl_{store_.get(), max_, get(str.get_cstr())} {
   }
 
   template<class TAG, class I>
@@ -609,14 +635,20 @@ namespace string
       store_{std::move(str.store_)}, impl_{str.impl_.reset()} {
   }
 
+  template<class TAG, class I>
+  inline
+  t_string<TAG, 0, I>::~t_string() {
+    dealloc_<TAG>(store_.release(), max_);
+  }
+
   template<class TAG, class I>
   inline
   t_void t_string<TAG, 0, I>::maybe_adjust_(t_n_ need) {
-    if (need > max_) {
+    if (need >= max_) {
       if (store_ == VALID)
-        dealloc_(store_.release());
+        dealloc_<TAG>(store_.release(), max_);
       max_   = calc_n_(need, blks_);
-      store_ = alloc_ (max_);
+      store_ = alloc_<TAG>(max_);
     }
   }
 
@@ -624,9 +656,10 @@ namespace string
   inline
   t_void t_string<TAG, 0, I>::maybe_readjust_(t_n_ need) {
     auto len = impl_.get_length(), left = max_ - len;
-    if (need > left) {
+    if (need >= left) {
+      auto old = max_;
       max_   = calc_n_ (len + need, blks_);
-      store_ = realloc_(store_.release(), max_);
+      store_ = realloc_<TAG>(store_.release(), old, max_);
     }
   }
 
@@ -691,7 +724,7 @@ namespace string
   inline
   typename t_string<TAG, 0, I>::r_string
       t_string<TAG, 0, I>::operator=(t_string<TAG, 0, I1>&& str) {
-    dealloc_(store_.release());
+    dealloc_<TAG>(store_.release(), max_);
     impl_.reset(str.impl_.reset());
     max_   = utility::reset(str.max_);
     blks_  = str.blks_;
@@ -796,6 +829,16 @@ namespace string
     return *this;
   }
 
+  template<class TAG, class I>
+  template<class F>
+  inline
+  typename t_string<TAG, 0, I>::r_string
+      t_string<TAG, 0, I>::append(t_n need, F f) {
+    maybe_readjust_(get(need));
+    impl_.append_(store_.get(), max_, get(need), f);
+    return *this;
+  }
+
   template<class TAG, class I>
   inline
   t_void t_string<TAG, 0, I>::display() const {
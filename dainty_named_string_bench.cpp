@@ -0,0 +1,315 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+// bench: compare t_string (fixed and dynamic) with std::string and
+//        snprintf on the common operations, per size class.
+//
+//   every case reports ns/op and heap allocations/op. allocations are
+//   counted by wrapping malloc, calloc and realloc of this executable,
+//   with glibc only (it exports __libc_malloc and co.), elsewhere they
+//   are shown as "-".
+//
+//   usage: dainty_named_string_bench [filter]
+//          only cases whose name contains filter are run.
+
+#include <time.h>
+#include <fnmatch.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include "dainty_named_string.h"
+
+#if defined(__GLIBC__)
+extern "C" {
+  void* __libc_malloc (size_t);
+  void* __libc_calloc (size_t, size_t);
+  void* __libc_realloc(void*, size_t);
+}
+#endif
+
+namespace
+{
+  using namespace dainty::named;
+  using namespace dainty::named::string;
+
+  t_uint64 allocs_ = 0;
+}
+
+#if defined(__GLIBC__)
+extern "C" void* malloc(size_t n) {
+  ++allocs_;
+  return __libc_malloc(n);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+  ++allocs_;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t n) {
+  ++allocs_;
+  return __libc_realloc(ptr, n);
+}
+#endif
+
+namespace
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  enum t_bench_tag_ {};
+
+  template<t_n_ N>
+  using t_fixed_ = t_string<t_bench_tag_, N>;
+  using t_dynamic_ = t_string<t_bench_tag_>;
+
+  P_cstr_ filter_ = nullptr;
+
+  template<class T>
+  inline
+  t_void escape_(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+  }
+
+  inline
+  t_uint64 now_() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (t_uint64)ts.tv_sec*1000000000ull + ts.tv_nsec;
+  }
+
+  template<class F>
+  t_void run_(P_cstr_ name, P_cstr_ impl, t_n_ size, F f) {
+    if (filter_ && !std::strstr(name, filter_))
+      return;
+
+    t_n_ loops = 1;
+    for (t_uint64 spent = 0; spent < 20000000 && loops < (1ul << 30);
+         loops *= 2) {
+      auto start = now_();
+      for (t_n_ i = 0; i < loops; ++i)
+        f();
+      spent = now_() - start;
+      if (spent >= 20000000)
+        break;
+    }
+
+    auto allocs = allocs_;
+    auto start  = now_();
+    for (t_n_ i = 0; i < loops; ++i)
+      f();
+    auto spent = now_() - start;
+    allocs = allocs_ - allocs;
+
+#if defined(__GLIBC__)
+    std::printf("%-14s %-10s %6lu %12.2f %10.3f\n", name, impl, size,
+                (double)spent/loops, (double)allocs/loops);
+#else
+    std::printf("%-14s %-10s %6lu %12.2f %10s\n", name, impl, size,
+                (double)spent/loops, "-");
+    (t_void)allocs;
+#endif
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<t_n_ SIZE>
+  t_void bench_size_() {
+    static t_char text[SIZE + 1];
+    for (t_n_ i = 0; i < SIZE; ++i)
+      text[i] = 'a' + i%26;
+    text[SIZE] = '\0';
+
+    const P_cstr   cstr{text};
+    const t_crange range{text, t_n{SIZE}};
+    const t_n_     half = SIZE/2;
+    const t_crange half_range{text, t_n{half}};
+    t_char         fmt_buf[SIZE + 64];
+
+    // construction
+    run_("construct", "fixed", SIZE, [&] {
+      t_fixed_<SIZE> str{cstr};
+      escape_(str);
+    });
+    run_("construct", "dynamic", SIZE, [&] {
+      t_dynamic_ str{cstr};
+      escape_(str);
+    });
+    run_("construct", "std", SIZE, [&] {
+      std::string str{text};
+      escape_(str);
+    });
+
+    // assign a literal (cstr), a range and a format
+    {
+      t_fixed_<SIZE> fixed;
+      t_dynamic_     dynamic;
+      std::string    std_str;
+      run_("assign_cstr", "fixed",   SIZE, [&] { escape_(fixed = cstr);   });
+      run_("assign_cstr", "dynamic", SIZE, [&] { escape_(dynamic = cstr); });
+      run_("assign_cstr", "std",     SIZE, [&] { escape_(std_str = text); });
+      run_("assign_range", "fixed",   SIZE, [&] { escape_(fixed = range); });
+      run_("assign_range", "dynamic", SIZE, [&] {
+        escape_(dynamic = range);
+      });
+      run_("assign_range", "std", SIZE, [&] {
+        escape_(std_str.assign(text, SIZE));
+      });
+      run_("assign_fmt", "fixed", SIZE, [&] {
+        escape_(fixed.assign(FMT, "%.*s%d", (int)(SIZE - 8), text, 1234567));
+      });
+      run_("assign_fmt", "dynamic", SIZE, [&] {
+        escape_(dynamic.assign(FMT, "%.*s%d", (int)(SIZE - 8), text,
+                               1234567));
+      });
+      run_("assign_fmt", "snprintf", SIZE, [&] {
+        std::snprintf(fmt_buf, sizeof(fmt_buf), "%.*s%d", (int)(SIZE - 8),
+                      text, 1234567);
+        escape_(fmt_buf);
+      });
+    }
+
+    // append two halves
+    {
+      t_fixed_<SIZE> fixed;
+      t_dynamic_     dynamic;
+      std::string    std_str;
+      run_("append_cstr", "fixed", SIZE, [&] {
+        fixed.clear();
+        fixed.append(half_range);
+        escape_(fixed.append(P_cstr{text + SIZE - half}));
+      });
+      run_("append_cstr", "dynamic", SIZE, [&] {
+        dynamic.clear();
+        dynamic.append(half_range);
+        escape_(dynamic.append(P_cstr{text + SIZE - half}));
+      });
+      run_("append_cstr", "std", SIZE, [&] {
+        std_str.clear();
+        std_str.append(text, half);
+        escape_(std_str.append(text + SIZE - half));
+      });
+      run_("append_range", "fixed", SIZE, [&] {
+        fixed.clear();
+        fixed.append(half_range);
+        escape_(fixed.append(half_range));
+      });
+      run_("append_range", "dynamic", SIZE, [&] {
+        dynamic.clear();
+        dynamic.append(half_range);
+        escape_(dynamic.append(half_range));
+      });
+      run_("append_range", "std", SIZE, [&] {
+        std_str.clear();
+        std_str.append(text, half);
+        escape_(std_str.append(text, half));
+      });
+      run_("append_fmt", "fixed", SIZE, [&] {
+        fixed.clear();
+        fixed.append(half_range);
+        escape_(fixed.append(FMT, "%.*s", (int)half, text));
+      });
+      run_("append_fmt", "dynamic", SIZE, [&] {
+        dynamic.clear();
+        dynamic.append(half_range);
+        escape_(dynamic.append(FMT, "%.*s", (int)half, text));
+      });
+      run_("append_fmt", "snprintf", SIZE, [&] {
+        auto n = std::snprintf(fmt_buf, sizeof(fmt_buf), "%.*s",
+                               (int)half, text);
+        std::snprintf(fmt_buf + n, sizeof(fmt_buf) - n, "%.*s", (int)half,
+                      text);
+        escape_(fmt_buf);
+      });
+    }
+
+    // compare, match and count on equal content
+    {
+      t_fixed_<SIZE> fixed1{cstr}, fixed2{cstr};
+      t_dynamic_     dynamic1{cstr}, dynamic2{cstr};
+      std::string    std1{text}, std2{text};
+      run_("compare", "fixed", SIZE, [&] {
+        escape_(fixed1 == fixed2);
+        escape_(fixed1 < fixed2);
+      });
+      run_("compare", "dynamic", SIZE, [&] {
+        escape_(dynamic1 == dynamic2);
+        escape_(dynamic1 < dynamic2);
+      });
+      run_("compare", "std", SIZE, [&] {
+        escape_(std1 == std2);
+        escape_(std1 < std2);
+      });
+      run_("is_match", "fixed", SIZE, [&] {
+        escape_(fixed1.is_match("ab*xy?"));
+      });
+      run_("is_match", "dynamic", SIZE, [&] {
+        escape_(dynamic1.is_match("ab*xy?"));
+      });
+      run_("is_match", "fnmatch", SIZE, [&] {
+        escape_(fnmatch("ab*xy?", text, 0));
+      });
+      run_("count", "fixed", SIZE, [&] {
+        escape_(fixed1.get_count('a'));
+      });
+      run_("count", "dynamic", SIZE, [&] {
+        escape_(dynamic1.get_count('a'));
+      });
+      run_("count", "std", SIZE, [&] {
+        escape_(std::count(std1.begin(), std1.end(), 'a'));
+      });
+    }
+
+    // growth: build SIZE chars 8 at a time from empty
+    run_("growth", "dynamic", SIZE, [&] {
+      t_dynamic_ str{t_n{0}, t_n{0}};
+      for (t_n_ i = 0; i < SIZE; i += 8)
+        str.append(t_crange{text + i, t_n{8}});
+      escape_(str);
+    });
+    run_("growth", "std", SIZE, [&] {
+      std::string str;
+      for (t_n_ i = 0; i < SIZE; i += 8)
+        str.append(text + i, 8);
+      escape_(str);
+    });
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1)
+    filter_ = argv[1];
+
+  std::printf("%-14s %-10s %6s %12s %10s\n", "case", "impl", "size",
+              "ns/op", "allocs/op");
+  bench_size_<16>();
+  bench_size_<64>();
+  bench_size_<512>();
+  bench_size_<4096>();
+  return 0;
+}
@@ -0,0 +1,319 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "dainty_named_string_codec.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    T_char HEX_[] = "0123456789abcdef";
+
+    T_char BASE64_ALPHABET_[2][65] = {
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+    };
+
+    struct t_base64_table_ {
+      t_int8 value[2][256];
+
+      t_base64_table_() {
+        for (t_n_ a = 0; a < 2; ++a) {
+          std::memset(value[a], -1, 256);
+          for (t_n_ i = 0; i < 64; ++i)
+            value[a][(t_uchar)BASE64_ALPHABET_[a][i]] = (t_int8)i;
+        }
+      }
+    };
+    const t_base64_table_ BASE64_TABLE_;
+
+    inline
+    t_int hex_value_(t_char c) {
+      if (c >= '0' && c <= '9')
+        return c - '0';
+      c |= 0x20;
+      if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+      return -1;
+    }
+
+    inline
+    t_void encode_base64_group_(p_cstr_ dst, P_uchar src, t_n_ n,
+                                P_cstr_ alphabet) {
+      t_uint32 bits = (t_uint32)src[0] << 16;
+      if (n > 1)
+        bits |= (t_uint32)src[1] << 8;
+      if (n > 2)
+        bits |= src[2];
+      dst[0] = alphabet[(bits >> 18) & 63];
+      dst[1] = alphabet[(bits >> 12) & 63];
+      dst[2] = n > 1 ? alphabet[(bits >> 6) & 63] : '=';
+      dst[3] = n > 2 ? alphabet[bits & 63]        : '=';
+    }
+
+    inline
+    t_void decode_base64_group_(p_uchar dst, P_cstr_ src, t_n_ n,
+                                t_base64 base64) {
+      const t_int8* value = BASE64_TABLE_.value[base64];
+      t_uint32 bits = 0;
+      for (t_n_ i = 0; i < n; ++i)
+        bits |= (t_uint32)value[(t_uchar)src[i]] << (18 - 6*i);
+      dst[0] = (t_uchar)(bits >> 16);
+      dst[1] = (t_uchar)(bits >> 8);
+      dst[2] = (t_uchar)bits;
+    }
+
+#if defined(__SSE2__)
+    inline
+    __m128i to_hex_(__m128i nibbles) {
+      auto alpha = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+      auto shift = _mm_add_epi8(_mm_set1_epi8('0'),
+                                _mm_and_si128(alpha, _mm_set1_epi8(39)));
+      return _mm_add_epi8(nibbles, shift);
+    }
+
+    t_n_ encode_hex_simd_(p_cstr_ dst, P_uchar src, t_n_ n) {
+      const auto mask = _mm_set1_epi8(0x0f);
+      t_n_ i = 0;
+      for (; i + 16 <= n; i += 16, dst += 32) {
+        auto v  = _mm_loadu_si128((const __m128i*)(src + i));
+        auto hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        auto lo = _mm_and_si128(v, mask);
+        _mm_storeu_si128((__m128i*)dst,
+                         to_hex_(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i*)(dst + 16),
+                         to_hex_(_mm_unpackhi_epi8(hi, lo)));
+      }
+      return i;
+    }
+
+    // 16 hex chars to 16 nibbles, sets bad when any char is not hex.
+    inline
+    __m128i from_hex_(__m128i c, t_int& bad) {
+      auto lc    = _mm_or_si128(c, _mm_set1_epi8(0x20));
+      auto digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                 _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+      auto alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a' - 1)),
+                                 _mm_cmplt_epi8(lc, _mm_set1_epi8('f' + 1)));
+      bad |= _mm_movemask_epi8(_mm_or_si128(digit, alpha)) ^ 0xffff;
+      return _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(c,  _mm_set1_epi8('0'))),
+        _mm_and_si128(alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a' - 10))));
+    }
+
+    inline
+    __m128i join_nibbles_(__m128i v) {
+      return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)),
+                                         4),
+                          _mm_srli_epi16(v, 8));
+    }
+
+    t_n_ check_hex_simd_(P_cstr_ src, t_n_ n, t_int& bad) {
+      t_n_ i = 0;
+      for (; i + 16 <= n; i += 16)
+        from_hex_(_mm_loadu_si128((const __m128i*)(src + i)), bad);
+      return i;
+    }
+
+    t_n_ decode_hex_simd_(p_cstr_ dst, P_cstr_ src, t_n_ n) {
+      t_int bad = 0;
+      t_n_ i = 0;
+      for (; i + 16 <= n; i += 16, src += 32) {
+        auto v0 = from_hex_(_mm_loadu_si128((const __m128i*)src),        bad);
+        auto v1 = from_hex_(_mm_loadu_si128((const __m128i*)(src + 16)), bad);
+        _mm_storeu_si128((__m128i*)(dst + i),
+                         _mm_packus_epi16(join_nibbles_(v0),
+                                          join_nibbles_(v1)));
+      }
+      return i;
+    }
+
+    // 12 input bytes (16 readable) to 16 base64 chars.
+    __attribute__((target("ssse3")))
+    t_n_ encode_base64_ssse3_(p_cstr_ dst, P_uchar src, t_n_ n,
+                              t_base64 base64) {
+      const auto shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4,  5, 3,  4, 1, 2, 0, 1);
+      const auto shift = base64 == BASE64 ?
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0) :
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+      t_n_ i = 0;
+      for (; i + 16 <= n; i += 12, dst += 16) {
+        auto in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i)),
+                                   shuffle);
+        auto t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        auto t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        auto t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        auto t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        auto ix = _mm_or_si128(t1, t3);
+        auto r  = _mm_subs_epu8(ix, _mm_set1_epi8(51));
+        auto lt = _mm_cmpgt_epi8(_mm_set1_epi8(26), ix);
+        r = _mm_or_si128(r, _mm_and_si128(lt, _mm_set1_epi8(13)));
+        r = _mm_add_epi8(_mm_shuffle_epi8(shift, r), ix);
+        _mm_storeu_si128((__m128i*)dst, r);
+      }
+      return i;
+    }
+
+    t_n_ encode_base64_simd_(p_cstr_ dst, P_uchar src, t_n_ n,
+                             t_base64 base64) {
+      static const t_bool ssse3 = __builtin_cpu_supports("ssse3");
+      return ssse3 ? encode_base64_ssse3_(dst, src, n, base64) : 0;
+    }
+#else
+    t_n_ encode_hex_simd_(p_cstr_, P_uchar, t_n_) {
+      return 0;
+    }
+
+    t_n_ check_hex_simd_(P_cstr_, t_n_, t_int&) {
+      return 0;
+    }
+
+    t_n_ decode_hex_simd_(p_cstr_, P_cstr_, t_n_) {
+      return 0;
+    }
+
+    t_n_ encode_base64_simd_(p_cstr_, P_uchar, t_n_, t_base64) {
+      return 0;
+    }
+#endif
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_void encode_hex_(p_cstr_ dst, t_n_ n, P_uchar src) {
+    auto bytes = n/2;
+    auto i = encode_hex_simd_(dst, src, bytes);
+    for (; i < bytes; ++i) {
+      dst[2*i]     = HEX_[src[i] >> 4];
+      dst[2*i + 1] = HEX_[src[i] & 0x0f];
+    }
+    if (n & 1)
+      dst[n - 1] = HEX_[src[bytes] >> 4];
+  }
+
+  t_n_ get_base64_length_(t_n_ n, t_base64 base64) {
+    if (base64 == BASE64)
+      return (n + 2)/3*4;
+    return n/3*4 + (n%3 ? n%3 + 1 : 0);
+  }
+
+  t_void encode_base64_(p_cstr_ dst, t_n_ max, P_uchar src, t_n_ n,
+                        t_base64 base64) {
+    P_cstr_ alphabet = BASE64_ALPHABET_[base64];
+    auto groups = max/4;
+    if (groups > n/3)
+      groups = n/3;
+    auto i = encode_base64_simd_(dst, src, groups*3, base64);
+    for (dst += i/3*4; i < groups*3; i += 3, dst += 4)
+      encode_base64_group_(dst, src + i, 3, alphabet);
+    auto left = max - groups*4;
+    if (left) {
+      t_char tail[4];
+      encode_base64_group_(tail, src + i, n - i < 3 ? n - i : 3, alphabet);
+      std::memcpy(dst, tail, left);
+    }
+  }
+
+  t_bool is_hex_(P_cstr_ src, t_n_ n) {
+    if (n & 1)
+      return false;
+    t_int bad = 0;
+    auto i = check_hex_simd_(src, n, bad);
+    if (bad)
+      return false;
+    for (; i < n; ++i)
+      if (hex_value_(src[i]) < 0)
+        return false;
+    return true;
+  }
+
+  t_void decode_hex_(p_cstr_ dst, t_n_ n, P_cstr_ src) {
+    auto i = decode_hex_simd_(dst, src, n);
+    for (; i < n; ++i)
+      dst[i] = (t_char)(hex_value_(src[2*i]) << 4 | hex_value_(src[2*i + 1]));
+  }
+
+  t_bool is_base64_(P_cstr_ src, t_n_ n, t_base64 base64, t_n_& need,
+                    t_n_& len) {
+    const t_int8* value = BASE64_TABLE_.value[base64];
+    t_n_ pad = 0;
+    if (n && src[n - 1] == '=')
+      pad = n > 1 && src[n - 2] == '=' ? 2 : 1;
+    if (base64 == BASE64 && n%4)
+      return false;
+    if (base64 == BASE64_URL && pad && n%4)
+      return false;
+    len = n - pad;
+    if (len%4 == 1)
+      return false;
+    for (t_n_ i = 0; i < len; ++i)
+      if (value[(t_uchar)src[i]] < 0)
+        return false;
+    need = len/4*3 + (len%4 ? len%4 - 1 : 0);
+    return true;
+  }
+
+  t_void decode_base64_(p_cstr_ dst, t_n_ n, P_cstr_ src, t_n_ len,
+                        t_base64 base64) {
+    auto d = (p_uchar)dst;
+    const t_int8* value = BASE64_TABLE_.value[base64];
+    t_n_ i = 0;
+    for (; i + 3 <= n; i += 3, src += 4) {
+      auto bits = (t_uint32)value[(t_uchar)src[0]] << 18 |
+                  (t_uint32)value[(t_uchar)src[1]] << 12 |
+                  (t_uint32)value[(t_uchar)src[2]] << 6  |
+                  (t_uint32)value[(t_uchar)src[3]];
+      d[i]     = (t_uchar)(bits >> 16);
+      d[i + 1] = (t_uchar)(bits >> 8);
+      d[i + 2] = (t_uchar)bits;
+    }
+    if (i < n) {
+      t_uchar tail[3];
+      auto left = len - i/3*4;
+      decode_base64_group_(tail, src, left < 4 ? left : 4, base64);
+      std::memcpy(d + i, tail, n - i);
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,136 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_STRING_CODEC_H_
+#define _DAINTY_NAMED_STRING_CODEC_H_
+
+// codec: hex and base64 encoding of bytes into a t_string and back.
+//
+//   encoding appends the text to a fixed or dynamic t_string, following its
+//   overflow policy (assert or truncate the output). decoding appends the
+//   bytes in the same way, but validates the whole input first and leaves
+//   the t_string untouched if it is INVALID.
+//
+//   BASE64     - standard alphabet, padded with '='.
+//   BASE64_URL - url and filename safe alphabet, not padded.
+
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  enum t_base64 { BASE64, BASE64_URL };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_void encode_hex_   (p_cstr_,  t_n_, P_uchar);
+  t_void encode_base64_(p_cstr_,  t_n_, P_uchar, t_n_, t_base64);
+  t_void decode_hex_   (p_cstr_,  t_n_, P_cstr_);
+  t_void decode_base64_(p_cstr_,  t_n_, P_cstr_, t_n_, t_base64);
+
+  t_n_   get_base64_length_(t_n_, t_base64);
+  t_bool is_hex_           (P_cstr_, t_n_);
+  t_bool is_base64_        (P_cstr_, t_n_, t_base64, t_n_&, t_n_&);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_string<TAG, N, I>& append_hex(t_string<TAG, N, I>& str,
+                                  R_byte_crange bytes) {
+    return str.append(t_n{2*get(bytes.n)}, [&](p_cstr_ dst, t_n_ n) {
+      encode_hex_(dst, n, begin(bytes));
+      return n;
+    });
+  }
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_string<TAG, N, I>& append_hex(t_string<TAG, N, I>& str, R_crange chars) {
+    return append_hex(str, t_byte_crange{(P_uchar)begin(chars), chars.n});
+  }
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_string<TAG, N, I>& append_base64(t_string<TAG, N, I>& str,
+                                     R_byte_crange bytes,
+                                     t_base64 base64 = BASE64) {
+    auto need = get_base64_length_(get(bytes.n), base64);
+    return str.append(t_n{need}, [&](p_cstr_ dst, t_n_ n) {
+      encode_base64_(dst, n, begin(bytes), get(bytes.n), base64);
+      return n;
+    });
+  }
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_string<TAG, N, I>& append_base64(t_string<TAG, N, I>& str,
+                                     R_crange chars,
+                                     t_base64 base64 = BASE64) {
+    return append_base64(str, t_byte_crange{(P_uchar)begin(chars), chars.n},
+                         base64);
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_validity decode_hex(t_string<TAG, N, I>& str, R_crange text) {
+    auto len = get(text.n);
+    if (!is_hex_(begin(text), len))
+      return INVALID;
+    str.append(t_n{len/2}, [&](p_cstr_ dst, t_n_ n) {
+      decode_hex_(dst, n, begin(text));
+      return n;
+    });
+    return VALID;
+  }
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_validity decode_base64(t_string<TAG, N, I>& str, R_crange text,
+                           t_base64 base64 = BASE64) {
+    t_n_ need = 0, len = 0;
+    if (!is_base64_(begin(text), get(text.n), base64, need, len))
+      return INVALID;
+    str.append(t_n{need}, [&](p_cstr_ dst, t_n_ n) {
+      decode_base64_(dst, n, begin(text), len, base64);
+      return n;
+    });
+    return VALID;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
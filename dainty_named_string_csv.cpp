@@ -0,0 +1,313 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "dainty_named_string_csv.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    template<class T>
+    inline
+    T* grow_(T* ptr, t_n_& max, t_n_ need) {
+      if (need <= max)
+        return ptr;
+      if (max < 64)
+        max = 64;
+      while (max < need)
+        max *= 2;
+      ptr = (T*)std::realloc(ptr, max*sizeof(T));
+      if (!ptr)
+        assert_now(P_cstr("realloc failed to allocate"));
+      return ptr;
+    }
+
+    inline
+    t_bool is_structural_(t_char c, t_char delimiter) {
+      return c == delimiter || c == '\n' || c == '\r';
+    }
+
+    // first delimiter, '\n' or '\r' in [src, end), or end.
+    inline
+    P_cstr_ find_structural_(P_cstr_ src, P_cstr_ end, t_char delimiter) {
+#if defined(__SSE2__)
+      const auto delim = _mm_set1_epi8(delimiter);
+      const auto lf    = _mm_set1_epi8('\n');
+      const auto cr    = _mm_set1_epi8('\r');
+      for (; end - src >= 16; src += 16) {
+        auto c = _mm_loadu_si128((const __m128i*)src);
+        auto m = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(c, delim), _mm_cmpeq_epi8(c, lf)),
+          _mm_cmpeq_epi8(c, cr));
+        auto mask = _mm_movemask_epi8(m);
+        if (mask)
+          return src + __builtin_ctz(mask);
+      }
+#endif
+      for (; src < end && !is_structural_(*src, delimiter); ++src)
+        ;
+      return src;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_csv_parser_impl_::t_csv_parser_impl_(R_csv_params params)
+    : params_(params) {
+  }
+
+  t_csv_parser_impl_::~t_csv_parser_impl_() {
+    std::free(fields_);
+    std::free(scratch_);
+    std::free(carry_);
+  }
+
+  t_void t_csv_parser_impl_::set_chunk_(P_cstr_ chunk, t_n_ n) {
+    pos_ = chunk;
+    end_ = chunk + n;
+  }
+
+  t_bool t_csv_parser_impl_::next_row_(t_bool final) {
+    if (carry_done_) {
+      carry_n_     = 0;
+      carry_scan_  = 0;
+      carry_state_ = ROW_START_;
+      carry_done_  = false;
+    }
+
+    P_cstr_ next = nullptr;
+    if (carry_n_) {
+      // complete the row that began in an earlier chunk. add one line at a
+      // time until the scan sees its end, the rest of the chunk is then
+      // used in place.
+      if (final)
+        next = parse_row_(carry_, carry_ + carry_n_, true);
+      while (!next && pos_ < end_) {
+        auto nl = (P_cstr_)std::memchr(pos_, '\n', end_ - pos_);
+        auto piece_end = nl ? nl + 1 : end_;
+        add_carry_(pos_, piece_end - pos_);
+        pos_ = piece_end;
+        if (scan_carry_()) {
+          next = parse_row_(carry_, carry_ + carry_n_, false);
+          if (next)
+            pos_ -= (carry_ + carry_n_) - next;
+        }
+      }
+      if (!next) {
+        if (final) {
+          carry_n_     = 0;
+          carry_scan_  = 0;
+          carry_state_ = ROW_START_;
+        }
+        return false;
+      }
+      carry_done_ = true;
+      row_.base_  = carry_;
+    } else {
+      if (pos_ == end_)
+        return false;
+      next = parse_row_(pos_, end_, final);
+      if (!next) {
+        add_carry_(pos_, end_ - pos_);
+        pos_ = end_;
+        return false;
+      }
+      row_.base_ = pos_;
+      pos_       = next;
+    }
+
+    row_.scratch_ = scratch_;
+    row_.fields_  = fields_;
+    row_.n_       = fields_n_;
+    ++rows_;
+    return true;
+  }
+
+  // parse one row of [base, end), returns where the next row begins or
+  // nullptr when the row is not complete (or there is no row when final).
+  P_cstr_ t_csv_parser_impl_::parse_row_(P_cstr_ base, P_cstr_ end,
+                                         t_bool final) {
+    const auto delimiter = params_.delimiter;
+    const auto quote     = params_.quote;
+
+    fields_n_  = 0;
+    scratch_n_ = 0;
+
+    auto pos = base;
+    while (pos < end && (*pos == '\n' || *pos == '\r'))
+      ++pos;
+    if (pos == end)
+      return nullptr;
+
+    for (;;) {
+      if (pos < end && *pos == quote) {
+        auto begin = pos + 1, src = begin;
+        auto copied = false;
+        for (;;) {
+          auto q = (P_cstr_)std::memchr(src, quote, end - src);
+          if (!q) {
+            if (!final)
+              return nullptr;
+            q = end; // unterminated, take the rest
+          } else if (q + 1 == end && !final) {
+            return nullptr; // could still be ""
+          } else if (q + 1 < end && q[1] == quote) {
+            if (!copied) {
+              add_field_(scratch_n_, 0, true);
+              copied = true;
+            }
+            add_scratch_(src, q + 1 - src);
+            src = q + 2;
+            continue;
+          }
+          if (copied) {
+            add_scratch_(src, q - src);
+            auto& field = fields_[fields_n_ - 1];
+            field.len = scratch_n_ - field.offset;
+          } else
+            add_field_(begin - base, q - begin, false);
+          pos = q < end ? q + 1 : end;
+          break;
+        }
+        if (pos < end && !is_structural_(*pos, delimiter))
+          pos = find_structural_(pos, end, delimiter);
+      } else {
+        auto stop = find_structural_(pos, end, delimiter);
+        add_field_(pos - base, stop - pos, false);
+        pos = stop;
+      }
+
+      if (pos == end)
+        return final ? end : nullptr;
+      if (*pos == delimiter) {
+        ++pos;
+        continue;
+      }
+      if (*pos == '\r') {
+        if (pos + 1 == end)
+          return final ? end : nullptr;
+        if (pos[1] == '\n')
+          ++pos;
+      }
+      return pos + 1;
+    }
+  }
+
+  t_void t_csv_parser_impl_::add_field_(t_n_ offset, t_n_ len,
+                                        t_bool scratch) {
+    fields_ = grow_(fields_, fields_max_, fields_n_ + 1);
+    fields_[fields_n_++] = t_csv_field_{offset, len, scratch};
+  }
+
+  t_void t_csv_parser_impl_::add_scratch_(P_cstr_ src, t_n_ n) {
+    scratch_ = grow_(scratch_, scratch_max_, scratch_n_ + n);
+    std::memcpy(scratch_ + scratch_n_, src, n);
+    scratch_n_ += n;
+  }
+
+  // follows parse_row_ over the carry bytes not scanned yet, returns true
+  // once the end of the row is in the carry. a '\r' is only taken as the
+  // end when the byte after it is there too.
+  t_bool t_csv_parser_impl_::scan_carry_() {
+    const auto delimiter = params_.delimiter;
+    const auto quote     = params_.quote;
+
+    auto    state = carry_state_;
+    P_cstr_ pos   = carry_ + carry_scan_;
+    P_cstr_ end   = carry_ + carry_n_;
+    auto    found = false;
+    for (; pos < end && !found; ++pos) {
+      auto c = *pos;
+      switch (state) {
+        case ROW_START_:
+          if (c == '\n' || c == '\r')
+            break;
+          // fall through
+        case FIELD_START_:
+          if (c == quote)
+            state = QUOTED_;
+          else if (c == delimiter)
+            state = FIELD_START_;
+          else if (c == '\n' || c == '\r')
+            found = true;
+          else
+            state = UNQUOTED_;
+          break;
+        case QUOTED_: {
+          auto q = (P_cstr_)std::memchr(pos, quote, end - pos);
+          if (!q) {
+            pos = end - 1;
+            break;
+          }
+          pos   = q;
+          state = QUOTE_;
+        } break;
+        case QUOTE_:
+          if (c == quote) {
+            state = QUOTED_; // escaped
+            break;
+          }
+          state = AFTER_QUOTE_;
+          // fall through
+        case UNQUOTED_:
+        case AFTER_QUOTE_:
+          if (c == delimiter)
+            state = FIELD_START_;
+          else if (c == '\n' || c == '\r')
+            found = true;
+          break;
+      }
+      if (found && c == '\r' && pos + 1 == end) {
+        found = false; // wait for the byte after it
+        break;
+      }
+    }
+    carry_scan_  = pos - carry_;
+    carry_state_ = state;
+    return found;
+  }
+
+  t_void t_csv_parser_impl_::add_carry_(P_cstr_ src, t_n_ n) {
+    carry_ = grow_(carry_, carry_max_, carry_n_ + n);
+    std::memcpy(carry_ + carry_n_, src, n);
+    carry_n_ += n;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
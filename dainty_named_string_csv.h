@@ -0,0 +1,194 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_STRING_CSV_H_
+#define _DAINTY_NAMED_STRING_CSV_H_
+
+// csv: streaming parser for delimited text (csv, tsv, ...).
+//
+//   input is fed in chunks of any size (file reads, socket reads) and every
+//   complete row is handed to a callback as a t_csv_row, a list of t_crange
+//   fields. fields point straight into the chunk. only a field with an
+//   escaped quote ("") is copied, into a scratch buffer of the parser, and
+//   only a row that spans two chunks is copied, into a carry buffer. the
+//   ranges of a row are valid during the callback only.
+//
+//   structure (delimiter, '\n' and '\r') is located 16 bytes at a time.
+//   quoted fields may contain delimiters and newlines. text after a closing
+//   quote up to the next delimiter is ignored. an empty field (a,,b) is an
+//   empty t_crange. empty lines are skipped, so a row of one empty field
+//   must be written as "" to be seen.
+//
+//   a row that spans chunks is scanned once, the parser keeps the state of
+//   the scan (in quotes or not) and parses the row when its end is seen.
+//
+//   t_csv_parser<TAG> parser;
+//   while (auto n = read(fd, buf, sizeof(buf)))
+//     parser.feed(t_crange{buf, t_n(n)}, [](const t_csv_row& row) { ... });
+//   parser.finish([](const t_csv_row& row) { ... });
+
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_csv_params {
+    t_char delimiter = ',';
+    t_char quote     = '"';
+
+    t_csv_params() = default;
+    t_csv_params(t_char _delimiter, t_char _quote = '"')
+      : delimiter(_delimiter), quote(_quote) {
+    }
+  };
+  using R_csv_params = t_prefix<t_csv_params>::R_;
+
+  struct t_csv_field_ {
+    t_n_   offset;
+    t_n_   len;
+    t_bool scratch;
+  };
+  using p_csv_field_ = t_prefix<t_csv_field_>::p_;
+  using P_csv_field_ = t_prefix<t_csv_field_>::P_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_csv_row {
+  public:
+    inline t_n get_size() const { return t_n{n_}; }
+
+    inline
+    t_crange get(t_ix ix) const {
+      assert_if_true<ASSERT_DEBUG, STRING_ASSERT_LEVEL_>(
+        named::get(ix) >= n_, P_cstr("csv row: ix out of range"));
+      const auto& field = fields_[named::get(ix)];
+      return t_crange{(field.scratch ? scratch_ : base_) + field.offset,
+                      t_n{field.len}};
+    }
+
+    template<class F>
+    inline
+    t_void each(F f) const {
+      for (t_ix_ ix = 0; ix < n_; ++ix)
+        f(get(t_ix{ix}));
+    }
+
+  private:
+    friend class t_csv_parser_impl_;
+    P_cstr_      base_    = nullptr;
+    P_cstr_      scratch_ = nullptr;
+    P_csv_field_ fields_  = nullptr;
+    t_n_         n_       = 0;
+  };
+  using R_csv_row = t_prefix<t_csv_row>::R_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_csv_parser_impl_ {
+  public:
+    using r_impl_ = t_prefix<t_csv_parser_impl_>::r_;
+
+     t_csv_parser_impl_(R_csv_params);
+    ~t_csv_parser_impl_();
+
+    t_csv_parser_impl_(const t_csv_parser_impl_&)    = delete;
+    r_impl_ operator= (const t_csv_parser_impl_&)    = delete;
+
+    t_void    set_chunk_(P_cstr_, t_n_);
+    t_bool    next_row_ (t_bool final);
+    R_csv_row get_row_  () const { return row_; }
+    t_n_      get_rows_ () const { return rows_; }
+
+  private:
+    P_cstr_ parse_row_(P_cstr_ base, P_cstr_ end, t_bool final);
+    t_void  add_field_(t_n_ offset, t_n_ len, t_bool scratch);
+    t_void  add_scratch_(P_cstr_, t_n_);
+    t_void  add_carry_  (P_cstr_, t_n_);
+    t_bool  scan_carry_ ();
+
+    enum t_scan_ { ROW_START_, FIELD_START_, UNQUOTED_, QUOTED_, QUOTE_,
+                   AFTER_QUOTE_ };
+
+    const t_csv_params params_;
+    P_cstr_       pos_         = nullptr;
+    P_cstr_       end_         = nullptr;
+    p_csv_field_  fields_      = nullptr;
+    t_n_          fields_n_    = 0;
+    t_n_          fields_max_  = 0;
+    p_cstr_       scratch_     = nullptr;
+    t_n_          scratch_n_   = 0;
+    t_n_          scratch_max_ = 0;
+    p_cstr_       carry_       = nullptr;
+    t_n_          carry_n_     = 0;
+    t_n_          carry_max_   = 0;
+    t_bool        carry_done_  = false;
+    t_n_          carry_scan_  = 0;
+    t_scan_       carry_state_ = ROW_START_;
+    t_n_          rows_        = 0;
+    t_csv_row     row_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG>
+  class t_csv_parser {
+  public:
+    t_csv_parser(R_csv_params params = t_csv_params{}) : impl_{params} {
+    }
+
+    // rows completed by this chunk, a partial last row waits for the next.
+    template<class F>
+    t_void feed(R_crange chunk, F f) {
+      impl_.set_chunk_(begin(chunk), named::get(chunk.n));
+      while (impl_.next_row_(false))
+        f(impl_.get_row_());
+    }
+
+    // the end of the input, completes a last row without a newline.
+    template<class F>
+    t_void finish(F f) {
+      impl_.set_chunk_(nullptr, 0);
+      while (impl_.next_row_(true))
+        f(impl_.get_row_());
+    }
+
+    t_n get_rows() const { return t_n{impl_.get_rows_()}; }
+
+  private:
+    t_csv_parser_impl_ impl_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
@@ -140,6 +140,16 @@ namespace string
     return min;
   }
 
+  t_n_ room_(t_n_ max, t_n_ need, t_overflow_assert) {
+    if (need > max - 1)
+      assert_now(P_cstr("buffer not big enough"));
+    return need;
+  }
+
+  t_n_ room_(t_n_ max, t_n_ need, t_overflow_truncate) {
+    return max - 1 < need ? max - 1 : need;
+  }
+
   t_void display_(P_cstr_ str) {
     std::printf("%s", str);
   }
@@ -34,12 +34,23 @@
 #include "dainty_named_ptr.h"
 #include "dainty_named_assert.h"
 
+// DAINTY_NAMED_STRING_ASSERT_LEVEL: assert level of the string module,
+// DAINTY_NAMED_ASSERT_LEVEL by default (see dainty_named_assert.h). index
+// checks are ASSERT_DEBUG, overflow and allocation checks ASSERT_ALWAYS.
+
+#ifndef DAINTY_NAMED_STRING_ASSERT_LEVEL
+#define DAINTY_NAMED_STRING_ASSERT_LEVEL DAINTY_NAMED_ASSERT_LEVEL
+#endif
+
 namespace dainty
 {
 namespace named
 {
 namespace string
 {
+  constexpr t_assert_level STRING_ASSERT_LEVEL_ =
+    (t_assert_level)DAINTY_NAMED_STRING_ASSERT_LEVEL;
+
   using named::t_bool;
   using named::t_void;
   using named::p_cstr_;
@@ -57,6 +68,11 @@ namespace string
   using t_crange = range::t_crange<t_char, t_crange_tag_>;
   using R_crange = t_prefix<t_crange>::R_;
 
+  enum  t_byte_range_tag_ {};
+  using t_byte_range  = range::t_range <t_uchar, t_byte_range_tag_>;
+  using t_byte_crange = range::t_crange<t_uchar, t_byte_range_tag_>;
+  using R_byte_crange = t_prefix<t_byte_crange>::R_;
+
 ///////////////////////////////////////////////////////////////////////////////
 
   template<t_n_ N>
@@ -108,12 +124,19 @@ namespace string
   t_n_ copy_ (p_cstr_, t_n_, P_cstr_,          t_overflow_truncate);
   t_n_ fill_ (p_cstr_, t_n_, R_block,          t_overflow_assert);
   t_n_ fill_ (p_cstr_, t_n_, R_block,          t_overflow_truncate);
+  t_n_ room_ (t_n_,    t_n_,                    t_overflow_assert);
+  t_n_ room_ (t_n_,    t_n_,                    t_overflow_truncate);
 
   t_n_     calc_n_  (t_n_, t_n_);
   p_cstr_  alloc_   (t_n_);
   t_void   dealloc_ (p_cstr_);
   p_cstr_  realloc_ (p_cstr_, t_n_);
 
+  t_ix_    add_string_stats_    (P_void, P_cstr_);
+  t_void   record_alloc_        (t_ix_, t_n_);
+  t_void   record_realloc_      (t_ix_, t_n_, t_n_);
+  t_void   record_dealloc_      (t_ix_, t_n_);
+
   t_void   display_ (P_cstr_);
   t_int    compare_ (P_cstr_, P_cstr_);
   t_bool   match_   (P_cstr_, P_cstr_ pattern);
@@ -121,6 +144,56 @@ namespace string
   t_n_     length_  (P_cstr_);
   t_n_     length_  (P_cstr_, va_list);
 
+////////////////////////////////////////////////////////////////////////////////
+
+  // the allocation of a dynamic t_string<TAG>. with DAINTY_NAMED_STRING_STATS
+  // defined every call is recorded against TAG (see string_stats.h).
+
+  // TAG is told apart by the address of its key, its name is for display.
+  template<class TAG>
+  struct t_string_stats_key_ {
+    static const t_char id;
+  };
+
+  template<class TAG>
+  const t_char t_string_stats_key_<TAG>::id = 0;
+
+  template<class TAG>
+  inline
+  t_ix_ get_string_stats_ix_() {
+    static const t_ix_ ix = add_string_stats_(&t_string_stats_key_<TAG>::id,
+                                              __PRETTY_FUNCTION__);
+    return ix;
+  }
+
+  template<class TAG>
+  inline
+  p_cstr_ alloc_(t_n_ n) {
+#ifdef DAINTY_NAMED_STRING_STATS
+    record_alloc_(get_string_stats_ix_<TAG>(), n);
+#endif
+    return alloc_(n);
+  }
+
+  template<class TAG>
+  inline
+  p_cstr_ realloc_(p_cstr_ str, [[maybe_unused]] t_n_ old, t_n_ n) {
+#ifdef DAINTY_NAMED_STRING_STATS
+    record_realloc_(get_string_stats_ix_<TAG>(), str ? old : 0, n);
+#endif
+    return realloc_(str, n);
+  }
+
+  template<class TAG>
+  inline
+  t_void dealloc_(p_cstr_ str, [[maybe_unused]] t_n_ n) {
+#ifdef DAINTY_NAMED_STRING_STATS
+    if (str)
+      record_dealloc_(get_string_stats_ix_<TAG>(), n);
+#endif
+    dealloc_(str);
+  }
+
 ////////////////////////////////////////////////////////////////////////////////
 
   struct t_del_ {
@@ -195,6 +268,16 @@ namespace string
       len_ += fill_(str + len_, max - len_, block, I());
     }
 
+    // f(dst, n) writes at most n chars of its output to dst and returns
+    // how many. n is need, or less when the overflow policy truncates.
+    template<class F>
+    inline
+    t_void append_(p_cstr_ str, t_n_ max, t_n_ need, F f) {
+      auto n = room_(max - len_, need, I());
+      len_ += f(str + len_, n);
+      str[len_] = '\0';
+    }
+
     inline
     t_void va_assign(p_cstr_ str, t_n_ max, P_cstr_ fmt, va_list vars) {
       len_ = build_(str, max, fmt, vars, I());
@@ -298,10 +381,9 @@ namespace string
 
     inline
     t_void mod_(p_cstr_ str, t_ix_ pos, t_char ch) {
-      if (pos < len_)
-        str[pos] = ch;
-      else
-        assert_now(P_cstr{"not in range"});
+      assert_if_true<ASSERT_DEBUG, STRING_ASSERT_LEVEL_>(
+        pos >= len_, P_cstr{"not in range"});
+      str[pos] = ch;
     }
 
   private:
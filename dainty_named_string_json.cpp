@@ -0,0 +1,277 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "dainty_named_string_json.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    T_char HEX_[] = "0123456789abcdef";
+
+    inline
+    t_bool is_special_(t_char c) {
+      return c == '"' || c == '\\' || (t_uchar)c < 0x20;
+    }
+
+    // n, lowered so that src[0, n) does not end inside a utf-8 sequence.
+    // src[n] must be readable.
+    inline
+    t_n_ cut_utf8_(P_cstr_ src, t_n_ n) {
+      while (n && ((t_uchar)src[n] & 0xc0) == 0x80)
+        --n;
+      return n;
+    }
+
+    // first '"', '\' or control character in [src, end), or end.
+    inline
+    P_cstr_ find_special_(P_cstr_ src, P_cstr_ end) {
+#if defined(__SSE2__)
+      const auto quote = _mm_set1_epi8('"');
+      const auto slash = _mm_set1_epi8('\\');
+      const auto ctrl  = _mm_set1_epi8(0x1f);
+      for (; end - src >= 16; src += 16) {
+        auto c = _mm_loadu_si128((const __m128i*)src);
+        auto m = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, slash)),
+          _mm_cmpeq_epi8(_mm_max_epu8(c, ctrl), ctrl));
+        auto mask = _mm_movemask_epi8(m);
+        if (mask)
+          return src + __builtin_ctz(mask);
+      }
+#endif
+      for (; src < end && !is_special_(*src); ++src)
+        ;
+      return src;
+    }
+
+    inline
+    t_n_ mk_escape_(p_cstr_ dst, t_char c) {
+      dst[0] = '\\';
+      switch (c) {
+        case '"':  dst[1] = '"';  return 2;
+        case '\\': dst[1] = '\\'; return 2;
+        case '\b': dst[1] = 'b';  return 2;
+        case '\f': dst[1] = 'f';  return 2;
+        case '\n': dst[1] = 'n';  return 2;
+        case '\r': dst[1] = 'r';  return 2;
+        case '\t': dst[1] = 't';  return 2;
+        default:
+          break;
+      }
+      dst[1] = 'u';
+      dst[2] = '0';
+      dst[3] = '0';
+      dst[4] = HEX_[(t_uchar)c >> 4];
+      dst[5] = HEX_[(t_uchar)c & 0x0f];
+      return 6;
+    }
+
+    inline
+    t_int hex_value_(t_char c) {
+      if (c >= '0' && c <= '9')
+        return c - '0';
+      c |= 0x20;
+      if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+      return -1;
+    }
+
+    inline
+    t_int32 get_hex4_(P_cstr_ src) {
+      t_int32 value = 0;
+      for (t_n_ i = 0; i < 4; ++i) {
+        auto v = hex_value_(src[i]);
+        if (v < 0)
+          return -1;
+        value = value << 4 | v;
+      }
+      return value;
+    }
+
+    inline
+    t_n_ mk_utf8_(p_cstr_ dst, t_uint32 cp) {
+      if (cp < 0x80) {
+        dst[0] = (t_char)cp;
+        return 1;
+      }
+      if (cp < 0x800) {
+        dst[0] = (t_char)(0xc0 | cp >> 6);
+        dst[1] = (t_char)(0x80 | (cp & 0x3f));
+        return 2;
+      }
+      if (cp < 0x10000) {
+        dst[0] = (t_char)(0xe0 | cp >> 12);
+        dst[1] = (t_char)(0x80 | (cp >> 6 & 0x3f));
+        dst[2] = (t_char)(0x80 | (cp & 0x3f));
+        return 3;
+      }
+      dst[0] = (t_char)(0xf0 | cp >> 18);
+      dst[1] = (t_char)(0x80 | (cp >> 12 & 0x3f));
+      dst[2] = (t_char)(0x80 | (cp >> 6 & 0x3f));
+      dst[3] = (t_char)(0x80 | (cp & 0x3f));
+      return 4;
+    }
+
+    // resolve the escape at src (src[0] == '\'). returns the number of
+    // input chars used and the output in out/out_n, or 0 when invalid.
+    t_n_ resolve_escape_(P_cstr_ src, P_cstr_ end, p_cstr_ out,
+                         t_n_& out_n) {
+      if (end - src < 2)
+        return 0;
+      out_n = 1;
+      switch (src[1]) {
+        case '"':  out[0] = '"';  return 2;
+        case '\\': out[0] = '\\'; return 2;
+        case '/':  out[0] = '/';  return 2;
+        case 'b':  out[0] = '\b'; return 2;
+        case 'f':  out[0] = '\f'; return 2;
+        case 'n':  out[0] = '\n'; return 2;
+        case 'r':  out[0] = '\r'; return 2;
+        case 't':  out[0] = '\t'; return 2;
+        case 'u':  break;
+        default:   return 0;
+      }
+      if (end - src < 6)
+        return 0;
+      auto cp = get_hex4_(src + 2);
+      if (cp < 0 || (cp >= 0xdc00 && cp <= 0xdfff))
+        return 0;
+      if (cp >= 0xd800 && cp <= 0xdbff) {
+        if (end - src < 12 || src[6] != '\\' || src[7] != 'u')
+          return 0;
+        auto low = get_hex4_(src + 8);
+        if (low < 0xdc00 || low > 0xdfff)
+          return 0;
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        out_n = mk_utf8_(out, cp);
+        return 12;
+      }
+      out_n = mk_utf8_(out, cp);
+      return 6;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_n_ get_json_escaped_length_(P_cstr_ src, t_n_ len) {
+    auto end = src + len;
+    t_n_ need = len;
+    for (src = find_special_(src, end); src < end;
+         src = find_special_(src + 1, end)) {
+      t_char tmp[6];
+      need += mk_escape_(tmp, *src) - 1;
+    }
+    return need;
+  }
+
+  t_n_ escape_json_(p_cstr_ dst, t_n_ n, P_cstr_ src, t_n_ len) {
+    auto end = src + len;
+    t_n_ pos = 0;
+    while (pos < n) {
+      auto special = find_special_(src, end);
+      t_n_ clean = special - src;
+      if (clean > n - pos) {
+        clean = cut_utf8_(src, n - pos);
+        std::memcpy(dst + pos, src, clean);
+        return pos + clean;
+      }
+      std::memcpy(dst + pos, src, clean);
+      pos += clean;
+      src += clean;
+      if (src == end)
+        break;
+      t_char tmp[6];
+      auto esc = mk_escape_(tmp, *src++);
+      if (esc > n - pos)
+        break;
+      std::memcpy(dst + pos, tmp, esc);
+      pos += esc;
+    }
+    return pos;
+  }
+
+  t_bool is_json_escaped_(P_cstr_ src, t_n_ len, t_n_& need) {
+    auto end = src + len;
+    need = 0;
+    for (;;) {
+      auto special = find_special_(src, end);
+      need += special - src;
+      if (special == end)
+        return true;
+      if (*special != '\\')
+        return false;
+      t_char tmp[4];
+      t_n_ out_n = 0;
+      auto used = resolve_escape_(special, end, tmp, out_n);
+      if (!used)
+        return false;
+      need += out_n;
+      src = special + used;
+    }
+  }
+
+  t_n_ unescape_json_(p_cstr_ dst, t_n_ n, P_cstr_ src, t_n_ len) {
+    auto end = src + len;
+    t_n_ pos = 0;
+    while (pos < n) {
+      auto slash = (P_cstr_)std::memchr(src, '\\', end - src);
+      t_n_ clean = (slash ? slash : end) - src;
+      if (clean > n - pos) {
+        clean = cut_utf8_(src, n - pos);
+        std::memcpy(dst + pos, src, clean);
+        return pos + clean;
+      }
+      std::memcpy(dst + pos, src, clean);
+      pos += clean;
+      src += clean;
+      if (src == end)
+        break;
+      t_char tmp[4];
+      t_n_ out_n = 0;
+      src += resolve_escape_(src, end, tmp, out_n);
+      if (out_n > n - pos)
+        break;
+      std::memcpy(dst + pos, tmp, out_n);
+      pos += out_n;
+    }
+    return pos;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_STRING_JSON_H_
+#define _DAINTY_NAMED_STRING_JSON_H_
+
+// json: escape text for use in a json string and undo it again.
+//
+//   escape_json appends the text with '"', '\' and control characters
+//   escaped. the special characters are located 16 at a time and the clean
+//   spans between them are copied in bulk.
+//
+//   unescape_json appends the text with all escapes resolved (\uXXXX to
+//   utf-8, surrogate pairs included). it validates the whole input first
+//   and leaves the t_string untouched if it is INVALID.
+//
+//   both follow the overflow policy of the t_string. when they truncate,
+//   they stop before an escape or utf-8 character that does not fit whole.
+
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  t_n_   get_json_escaped_length_(P_cstr_, t_n_);
+  t_n_   escape_json_             (p_cstr_, t_n_, P_cstr_, t_n_);
+  t_bool is_json_escaped_         (P_cstr_, t_n_, t_n_&);
+  t_n_   unescape_json_           (p_cstr_, t_n_, P_cstr_, t_n_);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_string<TAG, N, I>& escape_json(t_string<TAG, N, I>& str, R_crange text) {
+    auto len  = get(text.n);
+    auto need = get_json_escaped_length_(begin(text), len);
+    return str.append(t_n{need}, [&](p_cstr_ dst, t_n_ n) {
+      return escape_json_(dst, n, begin(text), len);
+    });
+  }
+
+  template<class TAG, t_n_ N, class I>
+  inline
+  t_validity unescape_json(t_string<TAG, N, I>& str, R_crange text) {
+    t_n_ len = get(text.n), need = 0;
+    if (!is_json_escaped_(begin(text), len, need))
+      return INVALID;
+    str.append(t_n{need}, [&](p_cstr_ dst, t_n_ n) {
+      return unescape_json_(dst, n, begin(text), len);
+    });
+    return VALID;
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
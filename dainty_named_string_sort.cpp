@@ -0,0 +1,247 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "dainty_named_assert.h"
+#include "dainty_named_range_parallel.h"
+#include "dainty_named_string_sort.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ SORT_SMALL_    = 24;
+    constexpr t_n_ SORT_PARALLEL_ = 1 << 16;
+
+    inline
+    t_uint64 load_prefix_(P_cstr_ str, t_n_ len, t_n_ depth) {
+      t_uint64 word = 0;
+      if (depth < len) {
+        auto left = len - depth;
+        if (left >= 8) {
+          std::memcpy(&word, str + depth, 8);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+          word = __builtin_bswap64(word);
+#endif
+        } else {
+          for (t_n_ i = 0; i < left; ++i)
+            word |= (t_uint64)(t_uchar)str[depth + i] << (56 - 8*i);
+        }
+      }
+      return word;
+    }
+
+    // keys have the same bytes before depth and their prefix holds the
+    // 8 bytes starting at depth.
+    inline
+    t_bool is_less_(const t_sort_key_& lh, const t_sort_key_& rh,
+                    t_n_ depth) {
+      if (lh.prefix != rh.prefix)
+        return lh.prefix < rh.prefix;
+      auto next = depth + 8;
+      if (lh.len > next && rh.len > next) {
+        auto min = (lh.len < rh.len ? lh.len : rh.len) - next;
+        auto cmp = std::memcmp(lh.str + next, rh.str + next, min);
+        if (cmp)
+          return cmp < 0;
+      }
+      return lh.len < rh.len;
+    }
+
+    inline
+    t_void swap_(t_sort_key_& lh, t_sort_key_& rh) {
+      t_sort_key_ tmp = lh;
+      lh = rh;
+      rh = tmp;
+    }
+
+    t_void insertion_sort_(p_sort_key_ keys, t_n_ n, t_n_ depth) {
+      for (t_n_ i = 1; i < n; ++i) {
+        t_sort_key_ key = keys[i];
+        t_n_ j = i;
+        for (; j && is_less_(key, keys[j - 1], depth); --j)
+          keys[j] = keys[j - 1];
+        keys[j] = key;
+      }
+    }
+
+    inline
+    t_uint64 median_(t_uint64 a, t_uint64 b, t_uint64 c) {
+      if (a < b)
+        return b < c ? b : (a < c ? c : a);
+      return a < c ? a : (b < c ? c : b);
+    }
+
+    // keys [0, n) share their first depth bytes.
+    struct t_sort_task_ {
+      p_sort_key_ keys;
+      t_n_        n;
+      t_n_        depth;
+    };
+
+    // one multikey quicksort step on task. equal keys that end within the
+    // prefix are put in order, the three parts left to sort (lesser,
+    // equal continuing 8 bytes deeper, greater) are returned smallest
+    // first.
+    t_void partition_(const t_sort_task_& task, t_sort_task_ (&parts)[3]) {
+      auto keys  = task.keys;
+      auto n     = task.n;
+      auto pivot = median_(keys[0].prefix, keys[n/2].prefix,
+                           keys[n - 1].prefix);
+
+      // [0, lt) < pivot, [lt, gt) == pivot, [gt, n) > pivot
+      t_n_ lt = 0, i = 0, gt = n;
+      while (i < gt) {
+        if (keys[i].prefix < pivot)
+          swap_(keys[lt++], keys[i++]);
+        else if (keys[i].prefix > pivot)
+          swap_(keys[i], keys[--gt]);
+        else
+          ++i;
+      }
+
+      // equal keys that end within the prefix are ordered by length
+      // and go first; the others continue 8 bytes deeper.
+      auto eq   = keys + lt;
+      t_n_ eq_n = gt - lt, done = 0, next = task.depth + 8;
+      for (t_n_ j = 0; j < eq_n; ++j)
+        if (eq[j].len <= next)
+          swap_(eq[done++], eq[j]);
+      std::sort(eq, eq + done, [](const t_sort_key_& lh,
+                                  const t_sort_key_& rh) {
+        return lh.len < rh.len;
+      });
+      auto rest   = eq + done;
+      t_n_ rest_n = eq_n - done;
+      for (t_n_ j = 0; j < rest_n; ++j)
+        rest[j].prefix = load_prefix_(rest[j].str, rest[j].len, next);
+
+      parts[0] = t_sort_task_{keys,      lt,     task.depth};
+      parts[1] = t_sort_task_{rest,      rest_n, next};
+      parts[2] = t_sort_task_{keys + gt, n - gt, task.depth};
+      if (parts[0].n > parts[1].n)
+        std::swap(parts[0], parts[1]);
+      if (parts[1].n > parts[2].n)
+        std::swap(parts[1], parts[2]);
+      if (parts[0].n > parts[1].n)
+        std::swap(parts[0], parts[1]);
+    }
+
+    // the two smaller parts recurse and the largest loops, so the stack
+    // depth stays O(log n) whatever the pivots are.
+    t_void mkqs_(t_sort_task_ task) {
+      while (task.n > SORT_SMALL_) {
+        t_sort_task_ parts[3];
+        partition_(task, parts);
+        mkqs_(parts[0]);
+        mkqs_(parts[1]);
+        task = parts[2];
+      }
+      insertion_sort_(task.keys, task.n, task.depth);
+    }
+
+    // cuts task into tasks of at most limit keys, in the same way.
+    t_void split_(std::vector<t_sort_task_>& tasks, t_sort_task_ task,
+                  t_n_ limit) {
+      while (task.n > limit) {
+        t_sort_task_ parts[3];
+        partition_(task, parts);
+        split_(tasks, parts[0], limit);
+        split_(tasks, parts[1], limit);
+        task = parts[2];
+      }
+      if (task.n)
+        tasks.push_back(task);
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  p_sort_key_ alloc_sort_keys_(t_n_ n) {
+    auto keys = (p_sort_key_)std::malloc(n*sizeof(t_sort_key_));
+    if (!keys)
+      assert_now(P_cstr("malloc failed to allocate"));
+    return keys;
+  }
+
+  t_void dealloc_sort_keys_(p_sort_key_ keys) {
+    std::free(keys);
+  }
+
+  t_uint64 mk_sort_prefix_(P_cstr_ str, t_n_ len) {
+    return load_prefix_(str, len, 0);
+  }
+
+  t_void fill_sort_keys_(p_sort_key_ keys, t_n_ n, p_sort_fill_ fill,
+                         p_void ctxt) {
+    if (n < SORT_PARALLEL_) {
+      fill(ctxt, keys, 0, n);
+      return;
+    }
+    auto chunk = [&](t_ix_ ix) {
+      t_n_ begin = ix*SORT_PARALLEL_, end = begin + SORT_PARALLEL_;
+      fill(ctxt, keys, begin, end < n ? end : n);
+    };
+    range::run_chunks_((n + SORT_PARALLEL_ - 1)/SORT_PARALLEL_, chunk);
+  }
+
+  // large inputs are cut into about 8 tasks per core, which run on the
+  // shared pool of range::run_parallel_, largest first.
+  t_void sort_keys_(p_sort_key_ keys, t_n_ n) {
+    const t_sort_task_ task{keys, n, 0};
+    t_n_ cores = std::thread::hardware_concurrency();
+    if (n < SORT_PARALLEL_ || cores < 2) {
+      mkqs_(task);
+      return;
+    }
+    t_n_ limit = n/(8*cores);
+    if (limit < SORT_PARALLEL_/8)
+      limit = SORT_PARALLEL_/8;
+
+    std::vector<t_sort_task_> tasks;
+    split_(tasks, task, limit);
+    std::sort(tasks.begin(), tasks.end(),
+              [](const t_sort_task_& lh, const t_sort_task_& rh) {
+      return lh.n > rh.n;
+    });
+    auto chunk = [&](t_ix_ ix) { mkqs_(tasks[ix]); };
+    range::run_chunks_(tasks.size(), chunk);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
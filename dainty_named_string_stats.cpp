@@ -0,0 +1,225 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include "dainty_named_string_stats.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ TAGS_  = 64;
+    constexpr t_n_ NAME_  = 64;
+    constexpr t_ix_ OTHER_ = TAGS_ - 1;
+
+    enum t_field_ {
+      ALLOCS_,
+      ALLOC_BYTES_,
+      REALLOCS_,
+      REALLOC_BYTES_,
+      DEALLOCS_,
+      LIVE_,
+      LIVE_BYTES_,
+      FIELDS_
+    };
+
+    // written only by its own thread, read by get_string_stats_.
+    struct t_shard_ {
+      std::atomic<t_uint64> fields[TAGS_][FIELDS_] = {};
+      t_shard_*             prev = nullptr;
+      t_shard_*             next = nullptr;
+    };
+
+    std::mutex lock_;
+    P_void     keys_[TAGS_];
+    t_char     names_[TAGS_][NAME_];
+    t_n_       names_n_ = 0;
+    t_n_       others_  = 0; // TAGs that found no room, under OTHER_
+    t_uint64   retired_[TAGS_][FIELDS_];
+    t_shard_*  shards_  = nullptr;
+
+    // the shard of this thread, and whether its owner is already destroyed.
+    // both are trivial, so they stay readable during thread and process
+    // teardown, when a t_string destructor may still record a dealloc.
+    thread_local t_shard_* shard_  = nullptr;
+    thread_local t_bool    exited_ = false;
+
+    struct t_shard_owner_ {
+      t_shard_owner_() {
+        shard_ = new t_shard_;
+        std::lock_guard<std::mutex> guard{lock_};
+        shard_->next = shards_;
+        if (shards_)
+          shards_->prev = shard_;
+        shards_ = shard_;
+      }
+
+     ~t_shard_owner_() {
+        std::lock_guard<std::mutex> guard{lock_};
+        auto shard = shard_;
+        for (t_ix_ ix = 0; ix < TAGS_; ++ix)
+          for (t_ix_ f = 0; f < FIELDS_; ++f)
+            retired_[ix][f] +=
+              shard->fields[ix][f].load(std::memory_order_relaxed);
+        if (shard->prev)
+          shard->prev->next = shard->next;
+        else
+          shards_ = shard->next;
+        if (shard->next)
+          shard->next->prev = shard->prev;
+        shard_  = nullptr;
+        exited_ = true;
+        delete shard;
+      }
+    };
+
+    t_shard_* mk_shard_() {
+      if (exited_)
+        return nullptr;
+      static thread_local t_shard_owner_ owner_;
+      return shard_;
+    }
+
+    inline
+    t_void add_(t_ix_ ix, t_field_ field, t_uint64 value) {
+      auto shard = shard_;
+      if (__builtin_expect(!shard, false) && !(shard = mk_shard_())) {
+        std::lock_guard<std::mutex> guard{lock_}; // after the owner is gone
+        retired_[ix][field] += value;
+        return;
+      }
+      auto& f = shard->fields[ix][field];
+      f.store(f.load(std::memory_order_relaxed) + value,
+              std::memory_order_relaxed);
+    }
+
+    // "... [with TAG = name]" (gcc) or "... [TAG = name]" (clang).
+    t_void copy_tag_(p_cstr_ dst, P_cstr_ func) {
+      P_cstr_ tag = std::strstr(func, "TAG = ");
+      tag = tag ? tag + 6 : func;
+      t_n_ n = std::strcspn(tag, ";]");
+      if (n > NAME_ - 1)
+        n = NAME_ - 1;
+      std::memcpy(dst, tag, n);
+      dst[n] = '\0';
+    }
+
+    t_void fold_(t_uint64 (&sum)[FIELDS_], t_ix_ ix) {
+      for (t_ix_ f = 0; f < FIELDS_; ++f)
+        sum[f] = retired_[ix][f];
+      for (auto shard = shards_; shard; shard = shard->next)
+        for (t_ix_ f = 0; f < FIELDS_; ++f)
+          sum[f] += shard->fields[ix][f].load(std::memory_order_relaxed);
+    }
+
+    t_string_stats mk_stats_(const t_uint64 (&sum)[FIELDS_]) {
+      t_string_stats stats;
+      stats.allocs        = sum[ALLOCS_];
+      stats.alloc_bytes   = sum[ALLOC_BYTES_];
+      stats.reallocs      = sum[REALLOCS_];
+      stats.realloc_bytes = sum[REALLOC_BYTES_];
+      stats.deallocs      = sum[DEALLOCS_];
+      stats.live          = (t_int64)sum[LIVE_];
+      stats.live_bytes    = (t_int64)sum[LIVE_BYTES_];
+      return stats;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_ix_ add_string_stats_(P_void key, P_cstr_ func) {
+    std::lock_guard<std::mutex> guard{lock_};
+    for (t_ix_ ix = 0; ix < names_n_; ++ix)
+      if (keys_[ix] == key)
+        return ix;
+    if (names_n_ == OTHER_) {
+      std::strcpy(names_[OTHER_], "<other>");
+      ++others_;
+      return OTHER_;
+    }
+    keys_[names_n_] = key;
+    copy_tag_(names_[names_n_], func);
+    return names_n_++;
+  }
+
+  t_void record_alloc_(t_ix_ ix, t_n_ n) {
+    add_(ix, ALLOCS_,      1);
+    add_(ix, ALLOC_BYTES_, n);
+    add_(ix, LIVE_,        1);
+    add_(ix, LIVE_BYTES_,  n);
+  }
+
+  t_void record_realloc_(t_ix_ ix, t_n_ old, t_n_ n) {
+    add_(ix, REALLOCS_,      1);
+    add_(ix, REALLOC_BYTES_, n - old);
+    add_(ix, LIVE_BYTES_,    n - old);
+    if (!old)
+      add_(ix, LIVE_, 1);
+  }
+
+  t_void record_dealloc_(t_ix_ ix, t_n_ n) {
+    add_(ix, DEALLOCS_,   1);
+    add_(ix, LIVE_,       (t_uint64)-1);
+    add_(ix, LIVE_BYTES_, (t_uint64)0 - n);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_string_stats get_string_stats_(t_ix_ ix) {
+    t_uint64 sum[FIELDS_];
+    std::lock_guard<std::mutex> guard{lock_};
+    fold_(sum, ix);
+    return mk_stats_(sum);
+  }
+
+  t_n_ get_string_stats_(p_string_stats_info infos, t_n_ max) {
+    std::lock_guard<std::mutex> guard{lock_};
+    t_n_ tags = names_n_ + (names_[OTHER_][0] ? 1 : 0), n = 0;
+    for (t_ix_ ix = 0; ix < TAGS_ && n < max && n < tags; ++ix) {
+      if (!names_[ix][0])
+        continue;
+      t_uint64 sum[FIELDS_];
+      fold_(sum, ix);
+      infos[n].tag   = names_[ix];
+      infos[n].tags  = ix == OTHER_ ? others_ : 1;
+      infos[n].stats = mk_stats_(sum);
+      ++n;
+    }
+    return n;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_STRING_STATS_H_
+#define _DAINTY_NAMED_STRING_STATS_H_
+
+// stats: heap activity of the dynamic t_string<TAG>, kept per TAG.
+//
+//   compiled in with DAINTY_NAMED_STRING_STATS (define it for the whole
+//   program). every alloc_, realloc_ and dealloc_ of a t_string<TAG, 0, I>
+//   is then counted against TAG in a shard owned by the calling thread, so
+//   recording costs a few relaxed increments and never shares a cache line.
+//
+//   get_string_stats() folds all shards (including those of threads that
+//   have exited) into a snapshot. live values are only exact when all
+//   threads are quiet. TAGs are told apart by type, their names are only
+//   for display. at most 63 TAGs are kept apart, the rest are counted
+//   together under "<other>", whose tags tells how many TAGs it holds.
+
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_string_stats {
+    t_uint64 allocs        = 0; // alloc_ calls
+    t_uint64 alloc_bytes   = 0; // bytes requested by alloc_
+    t_uint64 reallocs      = 0; // realloc_ calls, one per growth step
+    t_uint64 realloc_bytes = 0; // bytes added by realloc_
+    t_uint64 deallocs      = 0; // dealloc_ calls (with memory)
+    t_int64  live          = 0; // buffers allocated and not yet freed
+    t_int64  live_bytes    = 0; // bytes allocated and not yet freed
+  };
+  using r_string_stats = t_prefix<t_string_stats>::r_;
+  using R_string_stats = t_prefix<t_string_stats>::R_;
+
+  struct t_string_stats_info {
+    P_cstr_        tag  = nullptr;
+    t_n_           tags = 0; // TAGs counted here, more than 1 for "<other>"
+    t_string_stats stats;
+  };
+  using p_string_stats_info = t_prefix<t_string_stats_info>::p_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  t_string_stats get_string_stats_(t_ix_);
+  t_n_           get_string_stats_(p_string_stats_info, t_n_);
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG>
+  inline
+  t_string_stats get_string_stats() {
+    return get_string_stats_(get_string_stats_ix_<TAG>());
+  }
+
+  // all TAGs that allocated so far, returns how many were filled in.
+  template<t_n_ N>
+  inline
+  t_n get_string_stats(t_string_stats_info (&infos)[N]) {
+    return t_n{get_string_stats_(infos, N)};
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
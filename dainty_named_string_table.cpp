@@ -0,0 +1,228 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "dainty_named_assert.h"
+#include "dainty_named_string_sort.h"
+#include "dainty_named_string_table.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_uint32 TABLE_MAGIC_   = 0x54534e44; // "DNST"
+    constexpr t_uint32 TABLE_VERSION_ = 1;
+
+    struct t_table_header_ {
+      t_uint32 magic;
+      t_uint32 version;
+      t_uint64 entries;
+      t_uint64 bytes;
+    };
+
+    template<class T>
+    inline
+    T* grow_(T* ptr, t_n_ n) {
+      ptr = (T*)std::realloc(ptr, n*sizeof(T));
+      if (!ptr)
+        assert_now(P_cstr("realloc failed to allocate"));
+      return ptr;
+    }
+
+    inline
+    t_n_ next_max_(t_n_ max, t_n_ need) {
+      if (max < 64)
+        max = 64;
+      while (max < need)
+        max *= 2;
+      return max;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_string_table_impl_::t_string_table_impl_(t_n_ bytes, t_n_ entries) {
+    if (bytes)
+      grow_bytes_(bytes);
+    if (entries)
+      grow_entries_(entries);
+  }
+
+  t_string_table_impl_::t_string_table_impl_(x_impl_ impl)
+    : arena_      {utility::reset(impl.arena_)},
+      bytes_n_    {utility::reset(impl.bytes_n_)},
+      bytes_max_  {utility::reset(impl.bytes_max_)},
+      entries_    {utility::reset(impl.entries_)},
+      entries_n_  {utility::reset(impl.entries_n_)},
+      entries_max_{utility::reset(impl.entries_max_)} {
+  }
+
+  t_string_table_impl_::~t_string_table_impl_() {
+    std::free(arena_);
+    std::free(entries_);
+  }
+
+  t_string_table_impl_::r_impl_ t_string_table_impl_::operator=(x_impl_ impl) {
+    if (this != &impl) {
+      std::free(arena_);
+      std::free(entries_);
+      arena_       = utility::reset(impl.arena_);
+      bytes_n_     = utility::reset(impl.bytes_n_);
+      bytes_max_   = utility::reset(impl.bytes_max_);
+      entries_     = utility::reset(impl.entries_);
+      entries_n_   = utility::reset(impl.entries_n_);
+      entries_max_ = utility::reset(impl.entries_max_);
+    }
+    return *this;
+  }
+
+  t_void t_string_table_impl_::grow_bytes_(t_n_ need) {
+    bytes_max_ = next_max_(bytes_max_, need);
+    arena_     = grow_(arena_, bytes_max_);
+  }
+
+  t_void t_string_table_impl_::grow_entries_(t_n_ need) {
+    entries_max_ = next_max_(entries_max_, need);
+    entries_     = grow_(entries_, entries_max_);
+  }
+
+  t_ix_ t_string_table_impl_::add(P_cstr_ str, t_n_ len) {
+    if (bytes_n_ + len > bytes_max_) {
+      // str may be a view into the arena that is about to move.
+      auto offset = (std::uintptr_t)str - (std::uintptr_t)arena_;
+      t_bool own  = arena_ && offset < bytes_n_;
+      grow_bytes_(bytes_n_ + len);
+      if (own)
+        str = arena_ + offset;
+    }
+    if (entries_n_ == entries_max_)
+      grow_entries_(entries_n_ + 1);
+    if (len)
+      std::memcpy(arena_ + bytes_n_, str, len);
+    entries_[entries_n_] = t_string_entry_{bytes_n_, len};
+    bytes_n_ += len;
+    return entries_n_++;
+  }
+
+  t_void t_string_table_impl_::clear() {
+    bytes_n_   = 0;
+    entries_n_ = 0;
+  }
+
+  t_void t_string_table_impl_::sort() {
+    if (entries_n_ < 2)
+      return;
+
+    auto keys = alloc_sort_keys_(entries_n_);
+    for (t_n_ ix = 0; ix < entries_n_; ++ix) {
+      keys[ix].str    = arena_ + entries_[ix].offset;
+      keys[ix].len    = entries_[ix].len;
+      keys[ix].ix     = ix;
+      keys[ix].prefix = mk_sort_prefix_(keys[ix].str, keys[ix].len);
+    }
+    sort_keys_(keys, entries_n_);
+
+    // keys hold what is needed to rebuild the index in order.
+    for (t_n_ ix = 0; ix < entries_n_; ++ix)
+      entries_[ix] = t_string_entry_{(t_n_)(keys[ix].str - arena_),
+                                     keys[ix].len};
+    dealloc_sort_keys_(keys);
+  }
+
+  t_n_ t_string_table_impl_::get_serialized_size() const {
+    return sizeof(t_table_header_) + entries_n_*2*sizeof(t_uint64) + bytes_n_;
+  }
+
+  t_n_ t_string_table_impl_::serialize(p_uchar dst, t_n_ max) const {
+    auto size = get_serialized_size();
+    if (size > max)
+      return 0;
+
+    t_table_header_ header{TABLE_MAGIC_, TABLE_VERSION_, entries_n_, bytes_n_};
+    std::memcpy(dst, &header, sizeof(header));
+    dst += sizeof(header);
+    for (t_n_ ix = 0; ix < entries_n_; ++ix) {
+      t_uint64 entry[2] = { entries_[ix].offset, entries_[ix].len };
+      std::memcpy(dst, entry, sizeof(entry));
+      dst += sizeof(entry);
+    }
+    if (bytes_n_)
+      std::memcpy(dst, arena_, bytes_n_);
+    return size;
+  }
+
+  t_validity t_string_table_impl_::deserialize(P_uchar src, t_n_ max) {
+    t_table_header_ header;
+    if (max < sizeof(header))
+      return INVALID;
+    std::memcpy(&header, src, sizeof(header));
+    if (header.magic != TABLE_MAGIC_ || header.version != TABLE_VERSION_)
+      return INVALID;
+
+    auto left = max - sizeof(header);
+    if (header.entries > left/(2*sizeof(t_uint64)))
+      return INVALID;
+    auto index = header.entries*2*sizeof(t_uint64);
+    if (header.bytes != left - index)
+      return INVALID;
+
+    P_uchar entries = src + sizeof(header);
+    for (t_n_ ix = 0; ix < header.entries; ++ix) {
+      t_uint64 entry[2];
+      std::memcpy(entry, entries + ix*sizeof(entry), sizeof(entry));
+      if (entry[0] > header.bytes || entry[1] > header.bytes - entry[0])
+        return INVALID;
+    }
+
+    clear();
+    if (header.bytes > bytes_max_)
+      grow_bytes_(header.bytes);
+    if (header.entries > entries_max_)
+      grow_entries_(header.entries);
+    for (t_n_ ix = 0; ix < header.entries; ++ix) {
+      t_uint64 entry[2];
+      std::memcpy(entry, entries + ix*sizeof(entry), sizeof(entry));
+      entries_[ix] = t_string_entry_{entry[0], entry[1]};
+    }
+    if (header.bytes)
+      std::memcpy(arena_, entries + index, header.bytes);
+    entries_n_ = header.entries;
+    bytes_n_   = header.bytes;
+    return VALID;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,271 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_STRING_TABLE_H_
+#define _DAINTY_NAMED_STRING_TABLE_H_
+
+// table: many strings stored back to back in one growing byte arena.
+//
+//   an entry is an (offset, length) pair into the arena, so a string costs
+//   its bytes plus 16 bytes of index instead of a t_string header and its
+//   own allocation. entries are handed out as t_crange views, which stay
+//   valid until the next add() or clear(). such a view may itself be
+//   passed to add().
+//
+//   sort() orders the index by content (the arena is not touched). it
+//   renumbers the entries: a t_ix handed out before it names whatever
+//   string sorted into that position.
+//   serialize()/deserialize() use a flat native endian layout:
+//
+//     magic, version, entries, bytes | (offset, length) * entries | arena
+
+#include "dainty_named_string.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace string
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  struct t_string_entry_ {
+    t_n_ offset;
+    t_n_ len;
+  };
+  using p_string_entry_ = t_prefix<t_string_entry_>::p_;
+  using P_string_entry_ = t_prefix<t_string_entry_>::P_;
+
+///////////////////////////////////////////////////////////////////////////////
+
+  class t_string_table_impl_ {
+  public:
+    using r_impl_ = t_prefix<t_string_table_impl_>::r_;
+    using x_impl_ = t_prefix<t_string_table_impl_>::x_;
+
+     t_string_table_impl_(t_n_ bytes, t_n_ entries);
+     t_string_table_impl_(x_impl_);
+    ~t_string_table_impl_();
+
+    t_string_table_impl_(const t_string_table_impl_&)            = delete;
+    r_impl_ operator=   (const t_string_table_impl_&)            = delete;
+
+    r_impl_ operator=(x_impl_);
+
+    t_ix_      add(P_cstr_, t_n_);
+    t_void     clear();
+    t_void     sort();
+
+    t_n_       get_serialized_size() const;
+    t_n_       serialize  (p_uchar, t_n_) const;
+    t_validity deserialize(P_uchar, t_n_);
+
+    inline
+    t_crange get(t_ix_ ix) const {
+      assert_if_true<ASSERT_DEBUG, STRING_ASSERT_LEVEL_>(
+        ix >= entries_n_, P_cstr("string table: ix out of range"));
+      return t_crange{arena_ + entries_[ix].offset, t_n{entries_[ix].len}};
+    }
+
+    inline t_n_ get_size () const { return entries_n_; }
+    inline t_n_ get_bytes() const { return bytes_n_;   }
+
+  private:
+    t_void grow_bytes_  (t_n_);
+    t_void grow_entries_(t_n_);
+
+    p_cstr_         arena_       = nullptr;
+    t_n_            bytes_n_     = 0;
+    t_n_            bytes_max_   = 0;
+    p_string_entry_ entries_     = nullptr;
+    t_n_            entries_n_   = 0;
+    t_n_            entries_max_ = 0;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG>
+  class t_string_table {
+  public:
+    using r_table = typename t_prefix<t_string_table>::r_;
+    using x_table = typename t_prefix<t_string_table>::x_;
+
+    t_string_table(t_n bytes = t_n{4096}, t_n entries = t_n{64});
+    t_string_table(x_table);
+
+    r_table operator=(x_table);
+
+    t_ix add(P_cstr);
+    t_ix add(R_crange);
+    template<t_n_ N1>
+    t_ix add(const t_char (&)[N1]);
+    template<class TAG1, t_n_ N1, class I1>
+    t_ix add(const t_string<TAG1, N1, I1>&);
+
+    t_crange get(t_ix) const;
+
+    t_n  get_size () const;
+    t_n  get_bytes() const;
+    t_bool is_empty() const;
+
+    t_void clear();
+    t_void sort ();
+
+    template<class F> t_void  each(F) const;
+    template<class F> t_void ceach(F) const;
+
+    t_n        get_serialized_size() const;
+    t_n        serialize  (t_byte_range)  const;
+    t_validity deserialize(R_byte_crange);
+
+  private:
+    t_string_table_impl_ impl_;
+  };
+
+///////////////////////////////////////////////////////////////////////////////
+
+  template<class TAG>
+  inline
+  t_string_table<TAG>::t_string_table(t_n bytes, t_n entries)
+    : impl_{named::get(bytes), named::get(entries)} {
+  }
+
+  template<class TAG>
+  inline
+  t_string_table<TAG>::t_string_table(x_table table)
+    : impl_{utility::x_cast(table.impl_)} {
+  }
+
+  template<class TAG>
+  inline
+  typename t_string_table<TAG>::r_table
+      t_string_table<TAG>::operator=(x_table table) {
+    impl_ = utility::x_cast(table.impl_);
+    return *this;
+  }
+
+  template<class TAG>
+  inline
+  t_ix t_string_table<TAG>::add(P_cstr str) {
+    return t_ix{impl_.add(named::get(str), length_(named::get(str)))};
+  }
+
+  template<class TAG>
+  inline
+  t_ix t_string_table<TAG>::add(R_crange range) {
+    return t_ix{impl_.add(begin(range), named::get(range.n))};
+  }
+
+  template<class TAG>
+  template<t_n_ N1>
+  inline
+  t_ix t_string_table<TAG>::add(const t_char (&str)[N1]) {
+    return t_ix{impl_.add(str, N1 - 1)};
+  }
+
+  template<class TAG>
+  template<class TAG1, t_n_ N1, class I1>
+  inline
+  t_ix t_string_table<TAG>::add(const t_string<TAG1, N1, I1>& str) {
+    return t_ix{impl_.add(named::get(str.get_cstr()),
+                          named::get(str.get_length()))};
+  }
+
+  template<class TAG>
+  inline
+  t_crange t_string_table<TAG>::get(t_ix ix) const {
+    return impl_.get(named::get(ix));
+  }
+
+  template<class TAG>
+  inline
+  t_n t_string_table<TAG>::get_size() const {
+    return t_n{impl_.get_size()};
+  }
+
+  template<class TAG>
+  inline
+  t_n t_string_table<TAG>::get_bytes() const {
+    return t_n{impl_.get_bytes()};
+  }
+
+  template<class TAG>
+  inline
+  t_bool t_string_table<TAG>::is_empty() const {
+    return !impl_.get_size();
+  }
+
+  template<class TAG>
+  inline
+  t_void t_string_table<TAG>::clear() {
+    impl_.clear();
+  }
+
+  template<class TAG>
+  inline
+  t_void t_string_table<TAG>::sort() {
+    impl_.sort();
+  }
+
+  template<class TAG>
+  template<class F>
+  inline
+  t_void t_string_table<TAG>::each(F f) const {
+    for (t_ix_ ix = 0, n = impl_.get_size(); ix < n; ++ix)
+      f(t_ix{ix}, impl_.get(ix));
+  }
+
+  template<class TAG>
+  template<class F>
+  inline
+  t_void t_string_table<TAG>::ceach(F f) const {
+    each(f);
+  }
+
+  template<class TAG>
+  inline
+  t_n t_string_table<TAG>::get_serialized_size() const {
+    return t_n{impl_.get_serialized_size()};
+  }
+
+  template<class TAG>
+  inline
+  t_n t_string_table<TAG>::serialize(t_byte_range range) const {
+    return t_n{impl_.serialize(begin(range), named::get(range.n))};
+  }
+
+  template<class TAG>
+  inline
+  t_validity t_string_table<TAG>::deserialize(R_byte_crange range) {
+    return impl_.deserialize(begin(range), named::get(range.n));
+  }
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif
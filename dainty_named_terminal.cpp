@@ -24,7 +24,19 @@
 
 ******************************************************************************/
 
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "dainty_named_terminal.h"
+#include "dainty_named_terminal_uring.h"
 
 namespace dainty
 {
@@ -32,6 +44,558 @@ namespace named
 {
 namespace terminal
 {
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    std::atomic<t_fd_>  fd_      {1};
+    std::atomic<t_n_>   size_    {0};
+    std::atomic<t_nsec_> delay_  {0};
+    std::atomic<t_bool>  uring_  {false};
+
+    inline
+    t_nsec_ now_() {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+      return (t_nsec_)ts.tv_sec*1000000000ull + ts.tv_nsec;
+    }
+
+    t_void write_(t_fd_ fd, struct iovec* iov, t_int n) {
+      if (uring_.load(std::memory_order_relaxed) && write_uring_(fd, iov, n))
+        return;
+      while (n) {
+        auto done = ::writev(fd, iov, n);
+        if (done < 0) {
+          if (errno == EINTR)
+            continue;
+          return; // nowhere left to report it
+        }
+        for (; n && (t_n_)done >= iov->iov_len; ++iov, --n)
+          done -= iov->iov_len;
+        if (n) {
+          iov->iov_base = (p_char)iov->iov_base + done;
+          iov->iov_len -= done;
+        }
+      }
+    }
+
+    struct t_out_buf_ {
+      std::mutex  lock;
+      p_cstr_     data  = nullptr;
+      t_n_        len   = 0;
+      t_n_        max   = 0;
+      t_nsec_     first = 0;
+      t_out_buf_* prev  = nullptr;
+      t_out_buf_* next  = nullptr;
+
+      // lock must be held.
+      t_void flush(P_cstr_ str = nullptr, t_n_ n = 0) {
+        struct iovec iov[2] = {{data, len}, {(p_void)str, n}};
+        if (len || n)
+          write_(fd_.load(std::memory_order_relaxed), len ? iov : iov + 1,
+                 len ? (n ? 2 : 1) : 1);
+        len = 0;
+      }
+    };
+
+    // the buffers of exited threads are parked in free_bufs_ for the next
+    // thread and never freed: try_flush_all_out walks bufs_ without a lock
+    // and must not meet freed memory.
+    std::mutex  bufs_lock_;
+    t_out_buf_* bufs_      = nullptr;
+    t_out_buf_* free_bufs_ = nullptr;
+
+    struct t_out_buf_owner_ {
+      t_out_buf_owner_() {
+        std::lock_guard<std::mutex> guard{bufs_lock_};
+        if (free_bufs_) {
+          buf        = free_bufs_;
+          free_bufs_ = buf->next;
+        } else
+          buf = new t_out_buf_;
+        buf->prev = nullptr;
+        buf->next = bufs_;
+        if (bufs_)
+          bufs_->prev = buf;
+        bufs_ = buf;
+      }
+
+     ~t_out_buf_owner_() {
+        std::lock_guard<std::mutex> guard{bufs_lock_};
+        {
+          std::lock_guard<std::mutex> buf_guard{buf->lock};
+          buf->flush();
+        }
+        if (buf->prev)
+          buf->prev->next = buf->next;
+        else
+          bufs_ = buf->next;
+        if (buf->next)
+          buf->next->prev = buf->prev;
+        buf->prev  = nullptr;
+        buf->next  = free_bufs_;
+        free_bufs_ = buf;
+      }
+
+      t_out_buf_* buf = nullptr;
+    };
+
+    inline
+    t_out_buf_& get_buf_() {
+      static thread_local t_out_buf_owner_ owner_;
+      return *owner_.buf;
+    }
+
+    t_void out_sync_(P_cstr_ str, t_n_ n) {
+      const auto size = size_.load(std::memory_order_relaxed);
+      auto& buf = get_buf_();
+      std::lock_guard<std::mutex> guard{buf.lock};
+
+      if (buf.max != size) {
+        buf.flush();
+        auto data = (p_cstr_)std::realloc(buf.data, size);
+        if (data || !size) {
+          buf.data = data;
+          buf.max  = size;
+        } // else keep the old buffer, asserting here would come back to it
+      }
+
+      if (n > buf.max - buf.len) {
+        buf.flush(str, n); // buffer and line in one writev
+        return;
+      }
+
+      // a delay of 0 only flushes on size.
+      const auto delay = delay_.load(std::memory_order_relaxed);
+      const auto now   = delay ? now_() : 0;
+      if (!buf.len)
+        buf.first = now;
+      std::memcpy(buf.data + buf.len, str, n);
+      buf.len += n;
+      if (buf.len == buf.max || (delay && now - buf.first >= delay))
+        buf.flush();
+    }
+
+    t_void flush_all_sync_() {
+      std::lock_guard<std::mutex> guard{bufs_lock_};
+      for (auto buf = bufs_; buf; buf = buf->next) {
+        std::lock_guard<std::mutex> buf_guard{buf->lock};
+        buf->flush();
+      }
+    }
+
+    // with a size and a delay, a thread writes the buffers of threads that
+    // went quiet once their oldest line is older than delay.
+    struct t_flusher_ {
+      std::mutex              lock;
+      std::condition_variable cond;
+      std::thread             thread;
+      t_bool                  stop = false;
+
+      t_void run() {
+        std::unique_lock<std::mutex> guard{lock};
+        while (!stop) {
+          const auto delay = delay_.load(std::memory_order_relaxed);
+          cond.wait_for(guard, std::chrono::nanoseconds(delay));
+          if (stop)
+            break;
+          guard.unlock();
+          flush_stale(delay);
+          guard.lock();
+        }
+      }
+
+      t_void flush_stale(t_nsec_ delay) {
+        const auto now = now_();
+        std::lock_guard<std::mutex> list_guard{bufs_lock_};
+        for (auto buf = bufs_; buf; buf = buf->next) {
+          std::lock_guard<std::mutex> buf_guard{buf->lock};
+          if (buf->len && now - buf->first >= delay)
+            buf->flush();
+        }
+      }
+
+      t_void restart(t_bool on) {
+        if (thread.joinable()) {
+          {
+            std::lock_guard<std::mutex> guard{lock};
+            stop = true;
+            cond.notify_one();
+          }
+          thread.join();
+          stop = false;
+        }
+        if (on)
+          thread = std::thread{[this] { run(); }};
+      }
+
+     ~t_flusher_() {
+        restart(false);
+      }
+    };
+
+    t_flusher_ flusher_;
+
+//////////////////////////////////////////////////////////////////////////////
+
+    // bounded multi producer, single consumer ring of fixed size slots.
+    // a slot is free for position pos when seq == pos and holds the line
+    // of pos when seq == pos + 1 (d. vyukov's bounded queue).
+    //
+    // a producer claims its positions before it touches the ring, all the
+    // slots of a line in one step so that lines of other producers can not
+    // come in between. a line longer than the ring is written directly.
+    // while the ring is stopped tail has TAIL_CLOSED_ set, so that no
+    // position can be claimed. positions keep counting across a stop and
+    // a start.
+
+    constexpr t_n_ SLOT_LEN_    = 112;
+    constexpr t_n_ IOV_MAX_     = 1024;
+    constexpr t_n_ TAIL_CLOSED_ = (t_n_)1 << (sizeof(t_n_)*8 - 1);
+
+    struct t_slot_ {
+      std::atomic<t_n_> seq;
+      t_n_              len;
+      t_char            data[SLOT_LEN_];
+    };
+
+    struct t_async_ {
+      std::atomic<t_bool>     on{false};
+      t_slot_*                slots    = nullptr;
+      std::atomic<t_n_>       mask    {0};         // read before a claim
+      std::atomic<t_out_overflow> overflow{OUT_DROP};
+
+      alignas(64)
+      std::atomic<t_n_>       tail{TAIL_CLOSED_};
+
+      alignas(64)
+      t_n_                    head = 0;
+      std::atomic<t_n_>       done{0};
+      std::atomic<t_bool>     running{false};
+      std::atomic<t_bool>     sleeping{false};
+      std::mutex              lock;
+      std::condition_variable cond;
+      std::thread             writer;
+
+      std::atomic<t_uint64>   lines{0};
+      std::atomic<t_uint64>   bytes{0};
+      std::atomic<t_uint64>   writes{0};
+      std::atomic<t_uint64>   dropped{0};
+      std::atomic<t_uint64>   blocked{0};
+
+     ~t_async_() {
+        stop_out_async();
+      }
+    };
+
+    t_async_ async_;
+
+    // no fence: a wake up missed while the writer goes to sleep is only
+    // late, the writer waits at most 10ms.
+    inline
+    t_void wake_writer_() {
+      if (async_.sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> guard{async_.lock};
+        async_.cond.notify_one();
+      }
+    }
+
+    enum t_push_ { PUSHED_, DROPPED_, CLOSED_, TOO_LONG_ };
+
+    t_push_ push_(P_cstr_ str, t_n_ n) {
+      const t_n_ k = (n + SLOT_LEN_ - 1)/SLOT_LEN_;
+      auto pos = async_.tail.load(std::memory_order_relaxed);
+      t_bool waited = false;
+      for (;;) {
+        if (pos & TAIL_CLOSED_)
+          return CLOSED_;
+        const auto mask = async_.mask.load(std::memory_order_relaxed);
+        if (k > mask + 1)
+          return TOO_LONG_;
+        // the slot of pos is free once done has passed pos - slots. a
+        // stale pos is below done, its exchange fails and reloads it.
+        auto used = (std::intptr_t)(pos + k - 1 - async_.done.load(
+                                                std::memory_order_acquire));
+        if (used <= (std::intptr_t)mask) {
+          if (async_.tail.compare_exchange_weak(pos, pos + k,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed))
+            break;
+        } else {
+          if (async_.overflow.load(std::memory_order_relaxed) != OUT_BLOCK) {
+            async_.dropped.fetch_add(1, std::memory_order_relaxed);
+            return DROPPED_;
+          }
+          if (!waited) {
+            async_.blocked.fetch_add(1, std::memory_order_relaxed);
+            waited = true;
+          }
+          wake_writer_();
+          std::this_thread::yield();
+          pos = async_.tail.load(std::memory_order_relaxed);
+        }
+      }
+
+      const auto mask = async_.mask.load(std::memory_order_relaxed);
+      for (t_n_ len; n; str += len, n -= len, ++pos) {
+        len = n < SLOT_LEN_ ? n : SLOT_LEN_;
+        auto& slot = async_.slots[pos & mask];
+        std::memcpy(slot.data, str, len);
+        slot.len = len;
+        slot.seq.store(pos + 1, std::memory_order_release);
+      }
+      return PUSHED_;
+    }
+
+    // returns how much of str is left for the caller to write directly:
+    // all of it when the ring is closed under it or is too small for it.
+    t_n_ out_async_(P_cstr_ str, t_n_ n) {
+      if (!n)
+        return 0;
+      auto push = push_(str, n);
+      if (push == CLOSED_ || push == TOO_LONG_)
+        return n;
+      wake_writer_();
+      return 0;
+    }
+
+    t_void write_lines_() {
+      struct iovec iov[IOV_MAX_];
+      t_n_ bytes_n = 0;
+      t_int n = 0;
+      const auto mask = async_.mask.load(std::memory_order_relaxed);
+      for (auto pos = async_.head; n < (t_int)IOV_MAX_; ++pos, ++n) {
+        auto& slot = async_.slots[pos & mask];
+        if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+          break;
+        iov[n].iov_base = slot.data;
+        iov[n].iov_len  = slot.len;
+        bytes_n += slot.len;
+      }
+      if (!n)
+        return;
+
+      write_(fd_.load(std::memory_order_relaxed), iov, n);
+
+      for (t_int i = 0; i < n; ++i, ++async_.head)
+        async_.slots[async_.head & mask].seq.store(
+          async_.head + mask + 1, std::memory_order_release);
+      async_.done.store(async_.head, std::memory_order_release);
+      async_.lines .fetch_add(n,       std::memory_order_relaxed);
+      async_.bytes .fetch_add(bytes_n, std::memory_order_relaxed);
+      async_.writes.fetch_add(1,       std::memory_order_relaxed);
+    }
+
+    t_bool is_ring_empty_() {
+      auto& slot = async_.slots[async_.head &
+                                async_.mask.load(std::memory_order_relaxed)];
+      return slot.seq.load(std::memory_order_seq_cst) != async_.head + 1;
+    }
+
+    t_void run_writer_() {
+      t_uint64 reported = async_.dropped.load(std::memory_order_relaxed);
+      for (;;) {
+        if (!is_ring_empty_()) {
+          write_lines_();
+          continue;
+        }
+
+        if (async_.overflow.load(std::memory_order_relaxed) == OUT_COUNT) {
+          auto dropped = async_.dropped.load(std::memory_order_relaxed);
+          if (dropped != reported) {
+            t_char line[64];
+            auto n = std::snprintf(line, sizeof(line),
+                                   "out: %llu lines dropped\n",
+                                   (unsigned long long)(dropped - reported));
+            struct iovec iov{line, (t_n_)n};
+            write_(fd_.load(std::memory_order_relaxed), &iov, 1);
+            reported = dropped;
+          }
+        }
+
+        if (!async_.running.load(std::memory_order_acquire))
+          break;
+
+        std::unique_lock<std::mutex> guard{async_.lock};
+        async_.sleeping.store(true, std::memory_order_seq_cst);
+        if (is_ring_empty_() &&
+            async_.running.load(std::memory_order_acquire))
+          async_.cond.wait_for(guard, std::chrono::milliseconds(10));
+        async_.sleeping.store(false, std::memory_order_relaxed);
+      }
+    }
+
+    t_void flush_all_async_() {
+      const auto target = async_.tail.load(std::memory_order_acquire) &
+                          ~TAIL_CLOSED_;
+      {
+        std::lock_guard<std::mutex> guard{async_.lock};
+        async_.cond.notify_one();
+      }
+      // bounded, the writer may be the one that is stuck.
+      for (t_n_ i = 0; i < 10000; ++i) {
+        if ((std::intptr_t)(async_.done.load(std::memory_order_acquire) -
+                            target) >= 0)
+          return;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_void set_out_params(R_out_params params) {
+    flush_all_out();
+    fd_   .store(get(params.fd),   std::memory_order_relaxed);
+    size_ .store(get(params.size), std::memory_order_relaxed);
+    delay_.store((t_nsec_)get(params.delay)*1000000,
+                 std::memory_order_relaxed);
+    flusher_.restart(get(params.size) && get(params.delay));
+    if (params.sink == OUT_SINK_URING)
+      uring_.store(open_uring_(), std::memory_order_relaxed);
+    else if (uring_.exchange(false, std::memory_order_relaxed))
+      close_uring_();
+  }
+
+  t_out_params get_out_params() {
+    return t_out_params{t_fd  {fd_.load(std::memory_order_relaxed)},
+                        t_n   {size_.load(std::memory_order_relaxed)},
+                        t_msec{(t_msec_)(delay_.load(
+                                 std::memory_order_relaxed)/1000000)},
+                        uring_.load(std::memory_order_relaxed) ?
+                          OUT_SINK_URING : OUT_SINK_WRITEV};
+  }
+
+  t_void flush_out() {
+    if (async_.on.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> guard{async_.lock};
+      async_.cond.notify_one();
+      return;
+    }
+    auto& buf = get_buf_();
+    std::lock_guard<std::mutex> guard{buf.lock};
+    buf.flush();
+  }
+
+  t_void flush_all_out() {
+    flush_all_sync_();
+    if (async_.on.load(std::memory_order_acquire))
+      flush_all_async_();
+    wait_uring_();
+  }
+
+  t_void try_flush_all_out() {
+    // no locks and no io_uring: the caller may hold any of them, or be a
+    // signal handler that interrupted their owner. the buffers are read
+    // as they are, a buffer that its thread is changing can be cut. the
+    // nodes are never freed and data only goes to write(2), which fails
+    // instead of faulting on a buffer that was just reallocated.
+    const auto fd = fd_.load(std::memory_order_relaxed);
+    for (auto buf = bufs_; buf; buf = buf->next) {
+      P_cstr_ data = buf->data;
+      t_n_    len  = buf->len;
+      for (t_n_ pos = 0; data && pos < len && len <= buf->max; ) {
+        auto done = ::write(fd, data + pos, len - pos);
+        if (done < 0 && errno == EINTR)
+          continue;
+        if (done <= 0)
+          break;
+        pos += done;
+      }
+    }
+    if (async_.on.load(std::memory_order_acquire)) {
+      // the writer polls every 10ms, it is not woken to avoid its lock.
+      const auto target = async_.tail.load(std::memory_order_acquire) &
+                          ~TAIL_CLOSED_;
+      for (t_n_ i = 0; i < 500; ++i) {
+        if ((std::intptr_t)(async_.done.load(std::memory_order_acquire) -
+                            target) >= 0)
+          break;
+        struct timespec ts{0, 100000};
+        nanosleep(&ts, nullptr);
+      }
+    }
+  }
+
+  t_void out_(P_cstr_ str, t_n_ n) {
+    if (async_.on.load(std::memory_order_acquire)) {
+      auto left = out_async_(str, n);
+      if (!left)
+        return;
+      str += n - left;
+      n    = left;
+    }
+    out_sync_(str, n);
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_validity start_out_async(R_out_async_params params) {
+    if (async_.on.load() || async_.running.load())
+      return INVALID;
+
+    flush_all_sync_();
+
+    t_n_ slots = 64;
+    while (slots < get(params.slots))
+      slots *= 2;
+    auto ptr = (t_slot_*)std::malloc(slots*sizeof(t_slot_));
+    if (!ptr)
+      return INVALID;
+    // a producer that read tail before the last stop can only claim base,
+    // which is a valid position of the new ring.
+    const auto base = async_.tail.load(std::memory_order_relaxed) &
+                      ~TAIL_CLOSED_;
+    for (t_n_ pos = base; pos < base + slots; ++pos)
+      ptr[pos & (slots - 1)].seq.store(pos, std::memory_order_relaxed);
+
+    async_.slots    = ptr;
+    async_.mask    .store(slots - 1,       std::memory_order_relaxed);
+    async_.overflow.store(params.overflow, std::memory_order_relaxed);
+    async_.head     = base;
+    async_.done.store(base, std::memory_order_relaxed);
+    async_.running.store(true, std::memory_order_release);
+    async_.writer   = std::thread{run_writer_};
+    async_.tail.store(base, std::memory_order_release);
+    async_.on.store(true, std::memory_order_release);
+    return VALID;
+  }
+
+  t_void stop_out_async() {
+    if (!async_.running.load())
+      return;
+
+    // no new claims. a producer that claimed a position is still writing
+    // into the ring until done passes it.
+    async_.on.store(false, std::memory_order_relaxed);
+    const auto tail = async_.tail.fetch_or(TAIL_CLOSED_,
+                                           std::memory_order_acq_rel);
+    while ((std::intptr_t)(async_.done.load(std::memory_order_acquire) -
+                           tail) < 0)
+      std::this_thread::yield();
+
+    {
+      std::lock_guard<std::mutex> guard{async_.lock};
+      async_.running.store(false, std::memory_order_release);
+      async_.cond.notify_one();
+    }
+    async_.writer.join();
+    std::free(async_.slots);
+    async_.slots = nullptr;
+  }
+
+  t_out_stats get_out_stats() {
+    t_out_stats stats;
+    stats.lines   = async_.lines  .load(std::memory_order_relaxed);
+    stats.bytes   = async_.bytes  .load(std::memory_order_relaxed);
+    stats.writes  = async_.writes .load(std::memory_order_relaxed);
+    stats.dropped = async_.dropped.load(std::memory_order_relaxed);
+    stats.blocked = async_.blocked.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
   t_out::t_out(t_fmt, P_cstr_ fmt, ...) {
     va_list vars;
     va_start(vars, fmt);
@@ -47,7 +611,7 @@ namespace terminal
         else
           append("\n");
       }
-      display();
+      out_(get(get_cstr()), get(get_length()));
     }
   }
 
@@ -59,11 +623,14 @@ namespace terminal
         else
           out.append("\n");
       }
-      out.display();
+      out_(get(out.get_cstr()), get(out.get_length()));
       out.clear();
     }
+    flush_out();
     return out;
   }
+
+////////////////////////////////////////////////////////////////////////////////
 }
 }
 }
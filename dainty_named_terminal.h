@@ -27,6 +27,7 @@
 #ifndef _DAINTY_NAMED_TERMINAL_H_
 #define _DAINTY_NAMED_TERMINAL_H_
 
+#include <atomic>
 #include "dainty_named_string.h"
 
 namespace dainty
@@ -40,6 +41,91 @@ namespace terminal
   enum t_flush { FLUSH };
   enum t_clear { CLEAR };
 
+////////////////////////////////////////////////////////////////////////////////
+
+  // where t_out lines go. with a size, lines are collected in a buffer per
+  // thread and written to fd with one write. the buffer is written when it
+  // is full, on FLUSH, on flush_out(), when the thread exits and on
+  // assert_now. with a delay it is also written once its oldest line is
+  // older than delay, by the next line or by a flusher thread if none
+  // comes. a delay of 0 means size only. without a size every line is
+  // written on its own.
+  //
+  // the sink does the writes: OUT_SINK_WRITEV blocks in writev, while
+  // OUT_SINK_URING hands the output to io_uring and returns at once (see
+  // terminal_uring.h). it falls back to OUT_SINK_WRITEV when io_uring is
+  // not available, get_out_params() tells which one is used.
+
+  enum t_out_sink { OUT_SINK_WRITEV, OUT_SINK_URING };
+
+  struct t_out_params {
+    t_fd       fd    = t_fd{1};
+    t_n        size  = t_n{0};
+    t_msec     delay = t_msec{0};
+    t_out_sink sink  = OUT_SINK_WRITEV;
+
+    t_out_params() = default;
+    t_out_params(t_fd _fd, t_n _size, t_msec _delay,
+                 t_out_sink _sink = OUT_SINK_WRITEV)
+      : fd(_fd), size(_size), delay(_delay), sink(_sink) {
+    }
+  };
+  using R_out_params = t_prefix<t_out_params>::R_;
+
+  t_void       set_out_params(R_out_params);
+  t_out_params get_out_params();
+
+  t_void flush_out();     // the buffer of the calling thread
+  t_void flush_all_out(); // the buffers of all threads
+
+  // like flush_all_out(), but writes the buffers straight to the fd with
+  // write(), without taking a lock or going through io_uring, and waits at
+  // most 50ms for the async writer. it does not allocate or use stdio,
+  // which makes it usable from assert_now and signal handlers.
+  t_void try_flush_all_out();
+
+  t_void out_(P_cstr_, t_n_);
+
+////////////////////////////////////////////////////////////////////////////////
+
+  // async mode: t_out lines are pushed into a bounded lock-free ring and a
+  // writer thread drains it, many lines per writev. a line takes a slot
+  // per 112 bytes, claimed together so that it is never interleaved or
+  // cut; a line that needs more slots than the ring has is written
+  // directly. when the ring is full:
+  //
+  //   OUT_DROP  - the line is dropped.
+  //   OUT_BLOCK - the caller waits for room.
+  //   OUT_COUNT - the line is dropped and the writer reports how many were.
+  //
+  // FLUSH only wakes the writer. flush_all_out() waits until every line
+  // pushed before it has been written.
+
+  enum t_out_overflow { OUT_DROP, OUT_BLOCK, OUT_COUNT };
+
+  struct t_out_async_params {
+    t_n            slots    = t_n{4096}; // rounded up to a power of 2
+    t_out_overflow overflow = OUT_DROP;
+
+    t_out_async_params() = default;
+    t_out_async_params(t_n _slots, t_out_overflow _overflow)
+      : slots(_slots), overflow(_overflow) {
+    }
+  };
+  using R_out_async_params = t_prefix<t_out_async_params>::R_;
+
+  struct t_out_stats {
+    t_uint64 lines   = 0; // written by the writer thread
+    t_uint64 bytes   = 0;
+    t_uint64 writes  = 0;
+    t_uint64 dropped = 0;
+    t_uint64 blocked = 0; // pushes that had to wait for room
+  };
+
+  t_validity  start_out_async(R_out_async_params = t_out_async_params{});
+  t_void      stop_out_async ();
+  t_out_stats get_out_stats  ();
+
 ////////////////////////////////////////////////////////////////////////////////
 
   enum  t_out_tag_ { };
@@ -73,9 +159,69 @@ namespace terminal
     return (out += CLEAR);
   }
 
+///////////////////////////////////////////////////////////////////////////////
+
+  // levels: DAINTY_OUT(TAG, OUT_DEBUG, "x=%d", x) only evaluates and
+  // formats its arguments when the level is enabled.
+  //
+  //   compile time: levels below DAINTY_NAMED_OUT_LEVEL (default OUT_TRACE)
+  //                 are dead code and are removed by the compiler.
+  //   run time:     levels below the level of TAG (default OUT_INFO) cost
+  //                 one load and one branch. set it with set_out_level<TAG>.
+
+  enum t_out_level {
+    OUT_TRACE,
+    OUT_DEBUG,
+    OUT_INFO,
+    OUT_WARN,
+    OUT_ERROR,
+    OUT_OFF
+  };
+
+  template<class TAG>
+  struct t_out_level_ {
+    static inline std::atomic<t_out_level> level{OUT_INFO};
+  };
+
+  template<class TAG>
+  inline
+  t_void set_out_level(t_out_level level) {
+    t_out_level_<TAG>::level.store(level, std::memory_order_relaxed);
+  }
+
+  template<class TAG>
+  inline
+  t_out_level get_out_level() {
+    return t_out_level_<TAG>::level.load(std::memory_order_relaxed);
+  }
+
+  template<class TAG>
+  inline
+  t_bool is_out_level(t_out_level level) {
+    return level >= get_out_level<TAG>();
+  }
+
 ///////////////////////////////////////////////////////////////////////////////
 }
 }
 }
 
+#ifndef DAINTY_NAMED_OUT_LEVEL
+#define DAINTY_NAMED_OUT_LEVEL OUT_TRACE
+#endif
+
+#define DAINTY_OUT(TAG, LEVEL, ...)                                           \
+  do {                                                                        \
+    using namespace dainty::named::terminal;                                  \
+    if ((LEVEL) >= (DAINTY_NAMED_OUT_LEVEL) &&                                \
+        __builtin_expect(is_out_level<TAG>(LEVEL), 0))                        \
+      t_out{dainty::named::string::FMT, __VA_ARGS__};                         \
+  } while (false)
+
+#define DAINTY_OUT_TRACE(TAG, ...) DAINTY_OUT(TAG, OUT_TRACE, __VA_ARGS__)
+#define DAINTY_OUT_DEBUG(TAG, ...) DAINTY_OUT(TAG, OUT_DEBUG, __VA_ARGS__)
+#define DAINTY_OUT_INFO(TAG, ...)  DAINTY_OUT(TAG, OUT_INFO,  __VA_ARGS__)
+#define DAINTY_OUT_WARN(TAG, ...)  DAINTY_OUT(TAG, OUT_WARN,  __VA_ARGS__)
+#define DAINTY_OUT_ERROR(TAG, ...) DAINTY_OUT(TAG, OUT_ERROR, __VA_ARGS__)
+
 #endif
@@ -0,0 +1,358 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#include "dainty_named_terminal_uring.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace terminal
+{
+////////////////////////////////////////////////////////////////////////////////
+
+  namespace
+  {
+    constexpr t_n_ ENTRIES_  = 32;        // buffers and queue depth
+    constexpr t_n_ BUF_SIZE_ = 64*1024;
+
+    struct t_uring_ {
+      t_int         fd = -1;
+      p_void        sq_ptr   = nullptr;
+      t_n_          sq_len   = 0;
+      p_void        cq_ptr   = nullptr;
+      t_n_          cq_len   = 0;
+      io_uring_sqe* sqes     = nullptr;
+      t_n_          sqes_len = 0;
+      t_uint*       sq_head  = nullptr;
+      t_uint*       sq_tail  = nullptr;
+      t_uint*       sq_mask  = nullptr;
+      t_uint*       sq_array = nullptr;
+      t_uint*       cq_head  = nullptr;
+      t_uint*       cq_tail  = nullptr;
+      t_uint*       cq_mask  = nullptr;
+      io_uring_cqe* cqes     = nullptr;
+
+      p_uchar       bufs     = nullptr;
+      t_n_          lens[ENTRIES_];
+      t_fd_         fds [ENTRIES_];
+      t_uint64      free     = 0;       // bit per free buffer
+      t_n_          pending  = 0;       // prepared, not submitted
+      t_n_          inflight = 0;       // submitted, not completed
+      t_bool        broken   = false;   // later output is written directly
+
+     ~t_uring_() {
+        close_uring_();
+      }
+    };
+
+    std::mutex lock_;
+    t_uring_   uring_;
+
+    inline
+    t_int setup_(t_uint entries, io_uring_params* params) {
+      return (t_int)::syscall(__NR_io_uring_setup, entries, params);
+    }
+
+    inline
+    t_int enter_(t_uint submit, t_uint complete, t_uint flags) {
+      return (t_int)::syscall(__NR_io_uring_enter, uring_.fd, submit,
+                              complete, flags, nullptr, 0);
+    }
+
+    inline
+    t_int register_(t_uint opcode, p_void arg, t_uint n) {
+      return (t_int)::syscall(__NR_io_uring_register, uring_.fd, opcode,
+                              arg, n);
+    }
+
+    t_void write_all_(t_fd_ fd, P_uchar data, t_n_ n) {
+      while (n) {
+        auto done = ::write(fd, data, n);
+        if (done < 0) {
+          if (errno == EINTR)
+            continue;
+          return;
+        }
+        data += done;
+        n    -= done;
+      }
+    }
+
+    // only one submission is in flight at a time. its writes are linked,
+    // so they run in order and a failed or short write cancels the ones
+    // after it. the remainder and the cancelled writes are finished here,
+    // in order, before the next submission is made.
+    t_void reap_() {
+      auto head = *uring_.cq_head;
+      auto tail = __atomic_load_n(uring_.cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        auto& cqe = uring_.cqes[head & *uring_.cq_mask];
+        auto  ix  = (t_n_)cqe.user_data;
+        auto  len = uring_.lens[ix];
+        if (cqe.res < 0 || (t_n_)cqe.res < len) {
+          auto done = cqe.res < 0 ? 0 : (t_n_)cqe.res;
+          write_all_(uring_.fds[ix], uring_.bufs + ix*BUF_SIZE_ + done,
+                     len - done);
+        }
+        uring_.free |= 1ull << ix;
+        --uring_.inflight;
+      }
+      __atomic_store_n(uring_.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // io_uring_enter failed. the writes not yet taken by the kernel are
+    // taken back from the submission queue and written directly, like
+    // all later output.
+    t_void take_back_() {
+      auto tail = *uring_.sq_tail - (t_uint)uring_.pending;
+      for (t_uint i = 0; i < uring_.pending; ++i) {
+        auto ix = (t_n_)uring_.sqes[(tail + i) & *uring_.sq_mask].user_data;
+        write_all_(uring_.fds[ix], uring_.bufs + ix*BUF_SIZE_,
+                   uring_.lens[ix]);
+        uring_.free |= 1ull << ix;
+      }
+      __atomic_store_n(uring_.sq_tail, tail, __ATOMIC_RELEASE);
+      uring_.pending = 0;
+      uring_.broken  = true;
+    }
+
+    // waits until the submission in flight has completed in full.
+    t_bool wait_() {
+      for (reap_(); uring_.inflight; reap_())
+        if (enter_(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+          take_back_();
+          return false;
+        }
+      return true;
+    }
+
+    // waits for the submission in flight, then submits the pending writes
+    // as the next one. false when io_uring_enter fails.
+    t_bool submit_() {
+      if (!wait_())
+        return false;
+      if (uring_.pending) // the last write ends the chain
+        uring_.sqes[(*uring_.sq_tail - 1) & *uring_.sq_mask].flags &=
+          ~IOSQE_IO_LINK;
+      while (uring_.pending) {
+        auto n = enter_(uring_.pending, 0, 0);
+        if (n < 0) {
+          if (errno == EINTR)
+            continue;
+          take_back_();
+          return false;
+        }
+        uring_.inflight += n;
+        uring_.pending  -= n;
+      }
+      return true;
+    }
+
+    t_void drain_() {
+      if (submit_())
+        wait_();
+    }
+
+    // ENTRIES_ when io_uring_enter failed.
+    t_n_ get_buf_() {
+      if (!uring_.free)
+        reap_();
+      while (!uring_.free)
+        if (!(uring_.inflight ? wait_() : submit_()))
+          return ENTRIES_;
+      auto ix = (t_n_)__builtin_ctzll(uring_.free);
+      uring_.free &= ~(1ull << ix);
+      return ix;
+    }
+
+    t_void prepare_(t_fd_ fd, t_n_ ix, t_n_ len) {
+      auto  tail = *uring_.sq_tail;
+      auto  pos  = tail & *uring_.sq_mask;
+      auto& sqe  = uring_.sqes[pos];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode    = IORING_OP_WRITE_FIXED;
+      sqe.flags     = IOSQE_IO_LINK;
+      sqe.fd        = fd;
+      sqe.off       = (t_uint64)-1; // the current file position
+      sqe.addr      = (t_uint64)(uring_.bufs + ix*BUF_SIZE_);
+      sqe.len       = len;
+      sqe.buf_index = ix;
+      sqe.user_data = ix;
+      uring_.lens[ix] = len;
+      uring_.fds [ix] = fd;
+      uring_.sq_array[pos] = pos;
+      __atomic_store_n(uring_.sq_tail, tail + 1, __ATOMIC_RELEASE);
+      ++uring_.pending;
+    }
+
+    t_void close_() {
+      if (uring_.fd == -1)
+        return;
+      if (uring_.cqes)
+        drain_();
+
+      if (uring_.sqes)
+        ::munmap(uring_.sqes, uring_.sqes_len);
+      if (uring_.cq_ptr && uring_.cq_ptr != MAP_FAILED &&
+          uring_.cq_ptr != uring_.sq_ptr)
+        ::munmap(uring_.cq_ptr, uring_.cq_len);
+      if (uring_.sq_ptr && uring_.sq_ptr != MAP_FAILED)
+        ::munmap(uring_.sq_ptr, uring_.sq_len);
+      ::close(uring_.fd);
+      std::free(uring_.bufs);
+
+      uring_.fd     = -1;
+      uring_.sq_ptr = uring_.cq_ptr = nullptr;
+      uring_.sqes   = nullptr;
+      uring_.cqes   = nullptr;
+      uring_.bufs   = nullptr;
+      uring_.free   = 0;
+      uring_.broken = false;
+    }
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+
+  t_bool open_uring_() {
+    std::lock_guard<std::mutex> guard{lock_};
+    if (uring_.fd != -1)
+      return true;
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    auto fd = setup_(ENTRIES_, &params);
+    if (fd < 0)
+      return false;
+    uring_.fd = fd;
+
+    uring_.sq_len = params.sq_off.array + params.sq_entries*sizeof(t_uint);
+    uring_.cq_len = params.cq_off.cqes +
+                    params.cq_entries*sizeof(io_uring_cqe);
+    const t_bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && uring_.cq_len > uring_.sq_len)
+      uring_.sq_len = uring_.cq_len;
+
+    uring_.sq_ptr = ::mmap(nullptr, uring_.sq_len, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    uring_.cq_ptr = single ? uring_.sq_ptr
+                           : ::mmap(nullptr, uring_.cq_len,
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd,
+                                    IORING_OFF_CQ_RING);
+    uring_.sqes_len = params.sq_entries*sizeof(io_uring_sqe);
+    auto sqes = ::mmap(nullptr, uring_.sqes_len, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    uring_.bufs = (p_uchar)std::aligned_alloc(4096, ENTRIES_*BUF_SIZE_);
+
+    struct iovec iovs[ENTRIES_];
+    for (t_n_ ix = 0; uring_.bufs && ix < ENTRIES_; ++ix)
+      iovs[ix] = {uring_.bufs + ix*BUF_SIZE_, BUF_SIZE_};
+
+    if (uring_.sq_ptr == MAP_FAILED || uring_.cq_ptr == MAP_FAILED ||
+        sqes == MAP_FAILED || !uring_.bufs ||
+        register_(IORING_REGISTER_BUFFERS, iovs, ENTRIES_) < 0) {
+      if (sqes != MAP_FAILED)
+        uring_.sqes = (io_uring_sqe*)sqes;
+      close_();
+      return false;
+    }
+
+    auto sq = (p_uchar)uring_.sq_ptr, cq = (p_uchar)uring_.cq_ptr;
+    uring_.sqes     = (io_uring_sqe*)sqes;
+    uring_.sq_head  = (t_uint*)(sq + params.sq_off.head);
+    uring_.sq_tail  = (t_uint*)(sq + params.sq_off.tail);
+    uring_.sq_mask  = (t_uint*)(sq + params.sq_off.ring_mask);
+    uring_.sq_array = (t_uint*)(sq + params.sq_off.array);
+    uring_.cq_head  = (t_uint*)(cq + params.cq_off.head);
+    uring_.cq_tail  = (t_uint*)(cq + params.cq_off.tail);
+    uring_.cq_mask  = (t_uint*)(cq + params.cq_off.ring_mask);
+    uring_.cqes     = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    uring_.free     = ENTRIES_ == 64 ? ~0ull : (1ull << ENTRIES_) - 1;
+    return true;
+  }
+
+  t_void close_uring_() {
+    std::lock_guard<std::mutex> guard{lock_};
+    close_();
+  }
+
+  t_bool write_uring_(t_fd_ fd, const struct iovec* iov, t_int n) {
+    std::lock_guard<std::mutex> guard{lock_};
+    if (uring_.fd == -1 || uring_.broken)
+      return false;
+
+    t_n_ ix = get_buf_(), len = 0;
+    if (ix == ENTRIES_)
+      return false;
+    for (t_int i = 0; i < n; ++i) {
+      auto src = (P_uchar)iov[i].iov_base;
+      auto left = iov[i].iov_len;
+      while (left) {
+        if (len == BUF_SIZE_) {
+          prepare_(fd, ix, len);
+          ix  = get_buf_();
+          len = 0;
+          if (ix == ENTRIES_) {
+            write_all_(fd, src, left);
+            for (++i; i < n; ++i)
+              write_all_(fd, (P_uchar)iov[i].iov_base, iov[i].iov_len);
+            return true;
+          }
+        }
+        auto part = BUF_SIZE_ - len < left ? BUF_SIZE_ - len : left;
+        std::memcpy(uring_.bufs + ix*BUF_SIZE_ + len, src, part);
+        len  += part;
+        src  += part;
+        left -= part;
+      }
+    }
+    if (len)
+      prepare_(fd, ix, len);
+    else
+      uring_.free |= 1ull << ix;
+    submit_();
+    return true;
+  }
+
+  t_void wait_uring_() {
+    std::lock_guard<std::mutex> guard{lock_};
+    if (uring_.fd != -1)
+      drain_();
+  }
+
+////////////////////////////////////////////////////////////////////////////////
+}
+}
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+
+ MIT License
+
+ Copyright (c) 2018 kieme, frits.germs@gmx.net
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+******************************************************************************/
+
+#ifndef _DAINTY_NAMED_TERMINAL_URING_H_
+#define _DAINTY_NAMED_TERMINAL_URING_H_
+
+// terminal_uring: io_uring sink for the output of terminal (OUT_SINK_URING).
+//
+//   output is copied into one of a set of buffers registered with the
+//   kernel and handed over as a fixed buffer write. the caller copies
+//   while the previous submission is written and returns as soon as its
+//   own is submitted. a submission is only made once the one before it
+//   has completed in full, and its writes are linked, so a short write is
+//   finished directly before anything after it can run.
+//   when io_uring_enter fails, the rest is written directly and
+//   write_uring_ returns false from then on.
+//
+//   only the system call interface is used, liburing is not needed.
+
+#include <sys/uio.h>
+#include "dainty_named.h"
+
+namespace dainty
+{
+namespace named
+{
+namespace terminal
+{
+///////////////////////////////////////////////////////////////////////////////
+
+  t_bool open_uring_ ();                  // false if io_uring is unavailable
+  t_void close_uring_();                  // waits for all writes
+  t_bool write_uring_(t_fd_, const struct iovec*, t_int); // false if closed
+  t_void wait_uring_ ();                  // waits for all writes
+
+///////////////////////////////////////////////////////////////////////////////
+}
+}
+}
+
+#endif